@@ -79,6 +79,8 @@ IN THE SOFTWARE.
 #define FFLIPPED        10000   /* flipped reduce factor */
 #define FFLIPPEDPREC    10000000/* flipped reduce factor precision */
 #define INTERRUPTLIM    1024    /* check interrupt after that many decisions */
+#define GAUSSLIMIT      1e8     /* maximal bit operations of elimination */
+#define GAUSSWRDSZ      (8 * sizeof (unsigned long))
 
 #ifndef TRACE
 #define NO_BINARY_CLAUSES       /* store binary clauses more compactly */
@@ -127,6 +129,21 @@ IN THE SOFTWARE.
     (end) = (start) + new_num; \
   } while (0)
 
+#define RESERVE(start,head,end,n) \
+  do { \
+    unsigned old_num = (ptrdiff_t)((end) - (start)); \
+    size_t new_num = old_num ? old_num : 1; \
+    unsigned count = (head) - (start); \
+    assert ((start) <= (end)); \
+    while (new_num - count < (size_t)(n)) \
+      new_num *= 2; \
+    if (new_num == old_num) \
+      break; \
+    RESIZEN((start),old_num,new_num); \
+    (head) = (start) + count; \
+    (end) = (start) + new_num; \
+  } while (0)
+
 #define NOTLIT(l) (ps->lits + (1 ^ ((l) - ps->lits)))
 
 #define LIT2IDX(l) ((ptrdiff_t)((l) - ps->lits) / 2)
@@ -141,14 +158,23 @@ IN THE SOFTWARE.
 #define LIT2DHTPS(l) (ps->dhtps + (ptrdiff_t)((l) - ps->lits))
 #endif
 
-#ifdef NO_BINARY_CLAUSES
 typedef uintptr_t Wrd;
+
+#ifdef NO_BINARY_CLAUSES
 #define ISLITREASON(C) (1&(Wrd)C)
 #define LIT2REASON(L) \
   (assert (L->val==TRUE), ((Cls*)(1 + (2*(L - ps->lits)))))
 #define REASON2LIT(C) ((Lit*)(ps->lits + ((Wrd)C)/2))
 #endif
 
+/* Literals forced by cardinality constraints have the constraint as
+ * reason, tagged with '2' in the lower bits.  The clause is only generated
+ * when the reason is actually needed, e.g. during conflict analysis.
+ */
+#define ISCRDREASON(C) ((3&(Wrd)C) == 2)
+#define CRD2REASON(D) ((Cls*)(2 + (Wrd)(D)))
+#define REASON2CRD(C) ((Crd*)((Wrd)(C) - 2))
+
 #define ENDOFCLS(c) ((void*)((Lit**)(c)->lits + (c)->size))
 
 #define SOC ((ps->oclauses == ps->ohead) ? ps->lclauses : ps->oclauses)
@@ -387,6 +413,10 @@ typedef struct Lit Lit;         /* literal */
 typedef struct Rnk Rnk;         /* variable to score mapping */
 typedef signed char Val;        /* TRUE, UNDEF, FALSE */
 typedef struct Var Var;         /* variable */
+typedef struct Xor Xor;         /* xor constraint */
+typedef struct Xws Xws;         /* xor constraints watching a variable */
+typedef struct Crd Crd;         /* cardinality constraint */
+typedef struct Crs Crs;         /* cardinality constraints of a literal */
 #ifdef TRACE
 typedef struct Trd Trd;         /* trace data for clauses */
 typedef struct Zhn Zhn;         /* compressed chain (=zain) data */
@@ -460,8 +490,9 @@ struct Cls
   unsigned collected:1; /* bit 6 */
   unsigned core:1;      /* bit 7 */
 #endif
+  unsigned xreason:1;   /* bit 8 */
 
-#define LDMAXGLUE 25    /* 32 - 7 */
+#define LDMAXGLUE 24    /* 32 - 8 */
 #define MAXGLUE         ((1<<LDMAXGLUE)-1)
 
   unsigned glue:LDMAXGLUE;
@@ -470,6 +501,41 @@ struct Cls
   Lit *lits[2];
 };
 
+/* The variables of an xor constraint, where the first two are watched,
+ * have to add up to 'rhs' modulo two.  Only constraints with at least
+ * three variables are kept as such, shorter ones are added as clauses.
+ */
+struct Xor
+{
+  unsigned size : 31;
+  unsigned rhs : 1;
+  unsigned vars[2];             /* actually of length 'size' */
+};
+
+struct Xws
+{
+  Xor ** start, ** top, ** end;
+};
+
+/* At most 'bound' of the literals of a cardinality constraint can be true.
+ * Instead of watches it keeps a counter of its true literals, which are
+ * pushed in trail order on a stack behind the literals.  As soon as
+ * 'bound' literals are true, the remaining ones are forced to false, and
+ * the first 'bound' literals on the stack make up their reason.  Only
+ * constraints with 'bound + 1 < size' are kept as such.  Literals may occur
+ * more than once, and then count more than once.
+ */
+struct Crd
+{
+  unsigned size, bound, count;
+  Lit * lits[2];        /* actually 'size' literals and 'size' stack */
+};
+
+struct Crs
+{
+  Crd ** start, ** top, ** end;
+};
+
 #ifdef TRACE
 struct Zhn
 {
@@ -545,7 +611,7 @@ struct PicoSAT
 #else
   Cls **impls;
 #endif
-  Lit **trail, **thead, **eot, **ttail, ** ttail2;
+  Lit **trail, **thead, **eot, **ttail, ** ttail2, ** ttailxor, ** ttailcrd;
 #ifndef NADC
   Lit **ttailado;
 #endif
@@ -555,6 +621,8 @@ struct PicoSAT
   int *rils, *rilshead, *eorils;
   int *cils, *cilshead, *eocils;
   int *fals, *falshead, *eofals;
+  int *decs, *decshead, *eodecs;        /* decisions of last assignment */
+  int *exported, *exphead, *eoexp;      /* last exported clause */
   int *mass, szmass;
   int *mssass, szmssass;
   int *mcsass, nmcsass, szmcsass;
@@ -617,6 +685,7 @@ struct PicoSAT
   unsigned lastreduceconflicts;
   unsigned llocked;     /* locked large learned clauses */
   unsigned lrestart;
+  unsigned restartunit; /* restart interval unit in conflicts */
 #ifdef NLUBY
   unsigned drestart;
   unsigned ddrestart;
@@ -697,6 +766,21 @@ struct PicoSAT
   int addingtoado;
   int adodisabled;
 #endif
+  Xor ** xors, ** xhead, ** eoxors;
+  Xws * xws;                    /* indexed by variable */
+  unsigned szxws;
+  Cls * xorconflict;
+  unsigned xgauss;              /* xors seen by last elimination */
+  int addingtoxor;
+  unsigned xadded, xgaussed;    /* constraints, derived clauses */
+  unsigned xorprops, xorconflicts;
+  Crd ** crds, ** chead, ** eocrds;
+  Crs * crs;                    /* indexed by literal */
+  unsigned szcrs;
+  Cls * crdconflict;
+  Cls * crdimpl;                /* generated reason */
+  unsigned szcrdimpl;
+  unsigned cadded, crdprops, crdconflicts;
   unsigned long long flips;
 #ifdef STATS
   unsigned long long FORCED;
@@ -722,6 +806,20 @@ struct PicoSAT
     int (*function) (void *);
   } interrupt;
 
+  struct {
+    void * state;
+    void (*function) (void *, const int *, int, unsigned);
+    int maxsize;
+    unsigned maxglue;
+  } export;
+
+  struct {
+    void * state;
+    const int * (*function) (void *);
+  } import;
+  int importing;                /* adding an imported clause */
+  unsigned exports, imports;
+
 #ifdef VISCORES
   FILE * fviscores;
 #endif
@@ -1237,6 +1335,7 @@ init (void * pmgr,
 
   ps->lreduceadjustcnt = ps->lreduceadjustinc = 100;
   ps->lpropagations = ~0ull;
+  ps->restartunit = MINRESTART;
 
 #ifndef RCODE
   ps->out = stdout;
@@ -1345,6 +1444,7 @@ new_clause (PS * ps, unsigned size, unsigned learned)
 #endif
   res->locked = 0;
   res->used = 0;
+  res->xreason = 0;
 #ifdef TRACE
   res->core = 0;
   res->collected = 0;
@@ -1434,6 +1534,130 @@ lrelease (PS * ps, Ltk * stk)
 }
 #endif
 
+static size_t
+bytes_xor (unsigned size)
+{
+  assert (size >= 2);
+  return sizeof (Xor) + (size - 2) * sizeof (unsigned);
+}
+
+static int
+is_xor_reason (Cls * c)
+{
+#ifdef NO_BINARY_CLAUSES
+  if (ISLITREASON (c))
+    return 0;
+#endif
+  return c && !ISCRDREASON (c) && c->xreason;
+}
+
+static void
+resetxorconflict (PS * ps)
+{
+  assert (ps->xorconflict);
+  delete_clause (ps, ps->xorconflict);
+  ps->xorconflict = 0;
+}
+
+static void
+reset_xors (PS * ps)
+{
+  unsigned i;
+  Xor ** p;
+
+  /* reasons of xor propagations are only deleted when unassigned */
+  for (i = 1; i <= ps->max_var; i++)
+    if (ps->lits[2 * i].val != UNDEF && is_xor_reason (ps->vars[i].reason))
+      delete_clause (ps, ps->vars[i].reason);
+
+  for (p = ps->xors; p < ps->xhead; p++)
+    delete (ps, *p, bytes_xor ((*p)->size));
+
+  DELETEN (ps->xors, ps->eoxors - ps->xors);
+  ps->xhead = ps->eoxors = 0;
+
+  for (i = 0; i < ps->szxws; i++)
+    DELETEN (ps->xws[i].start, ps->xws[i].end - ps->xws[i].start);
+
+  DELETEN (ps->xws, ps->szxws);
+  ps->szxws = 0;
+
+  if (ps->xorconflict)
+    resetxorconflict (ps);
+}
+
+static size_t
+bytes_crd (unsigned size)
+{
+  assert (size >= 1);
+  return sizeof (Crd) + (2 * size - 2) * sizeof (Lit *);
+}
+
+static void
+resetcrdconflict (PS * ps)
+{
+  assert (ps->crdconflict);
+  delete_clause (ps, ps->crdconflict);
+  ps->crdconflict = 0;
+}
+
+static void
+reset_crds (PS * ps)
+{
+  unsigned i;
+  Crd ** p;
+
+  for (p = ps->crds; p < ps->chead; p++)
+    delete (ps, *p, bytes_crd ((*p)->size));
+
+  DELETEN (ps->crds, ps->eocrds - ps->crds);
+  ps->chead = ps->eocrds = 0;
+
+  for (i = 0; i < ps->szcrs; i++)
+    DELETEN (ps->crs[i].start, ps->crs[i].end - ps->crs[i].start);
+
+  DELETEN (ps->crs, ps->szcrs);
+  ps->szcrs = 0;
+
+  if (ps->crdimpl)
+    {
+      ps->crdimpl->size = ps->szcrdimpl;
+      delete_clause (ps, ps->crdimpl);
+      ps->crdimpl = 0;
+      ps->szcrdimpl = 0;
+    }
+
+  if (ps->crdconflict)
+    resetcrdconflict (ps);
+}
+
+/* Generate the reason of 'lit' forced by 'd', which is only valid until
+ * the next reason is generated.
+ */
+static Cls *
+crd2impl (PS * ps, Lit * lit, Crd * d)
+{
+  Lit ** p, ** q, ** eos;
+  Cls * res;
+
+  assert (lit->val == TRUE);
+  assert (d->count >= d->bound);
+  assert (d->bound < ps->szcrdimpl);
+
+  res = ps->crdimpl;
+  res->size = d->bound + 1;
+  q = res->lits;
+  *q++ = lit;
+  eos = d->lits + d->size + d->bound;
+  for (p = d->lits + d->size; p < eos; p++)
+    {
+      assert ((*p)->val == TRUE);
+      *q++ = NOTLIT (*p);
+    }
+
+  return res;
+}
+
 #ifndef NADC
 
 static unsigned
@@ -1483,6 +1707,8 @@ reset (PS * ps)
   ABORTIF (!ps ||
            ps->state == RESET, "API usage: reset without initialization");
 
+  reset_xors (ps);              /* before reasons are deleted */
+  reset_crds (ps);
   delete_clauses (ps);
 #ifdef TRACE
   delete_zhains (ps);
@@ -1516,6 +1742,8 @@ reset (PS * ps)
   DELETEN (ps->rils, ps->eorils - ps->rils);
   DELETEN (ps->cils, ps->eocils - ps->cils);
   DELETEN (ps->fals, ps->eofals - ps->fals);
+  DELETEN (ps->decs, ps->eodecs - ps->decs);
+  DELETEN (ps->exported, ps->eoexp - ps->exported);
   DELETEN (ps->mass, ps->szmass);
   DELETEN (ps->mssass, ps->szmssass);
   DELETEN (ps->mcsass, ps->szmcsass);
@@ -1550,12 +1778,16 @@ tpush (PS * ps, Lit * lit)
     {
       unsigned ttail2count = ps->ttail2 - ps->trail;
       unsigned ttailcount = ps->ttail - ps->trail;
+      unsigned ttailxorcount = ps->ttailxor - ps->trail;
+      unsigned ttailcrdcount = ps->ttailcrd - ps->trail;
 #ifndef NADC
       unsigned ttailadocount = ps->ttailado - ps->trail;
 #endif
       ENLARGE (ps->trail, ps->thead, ps->eot);
       ps->ttail = ps->trail + ttailcount;
       ps->ttail2 = ps->trail + ttail2count;
+      ps->ttailxor = ps->trail + ttailxorcount;
+      ps->ttailcrd = ps->trail + ttailcrdcount;
 #ifndef NADC
       ps->ttailado = ps->trail + ttailadocount;
 #endif
@@ -1806,6 +2038,9 @@ add_antecedent (PS * ps, Cls * c)
 {
   assert (c);
 
+  if (c == ps->crdimpl)
+    return;
+
 #ifdef NO_BINARY_CLAUSES
   if (ISLITREASON (c))
     return;
@@ -1990,6 +2225,8 @@ assign_forced (PS * ps, Lit * lit, Cls * reason)
       assert (reason);
     }
 #endif
+  if (ISCRDREASON (reason) && !ps->LEVEL)
+    reason = crd2impl (ps, lit, REASON2CRD (reason));
   LOG ( fprintf (ps->out,
                 "%sassign %d at level %d by ",
                 ps->prefix, LIT2INT (lit), ps->LEVEL);
@@ -2003,6 +2240,7 @@ assign_forced (PS * ps, Lit * lit, Cls * reason)
     {
       reason = resolve_top_level_unit (ps, lit, reason);
       assert (reason);
+      assert (reason != ps->crdimpl);
     }
 
 #ifdef NO_BINARY_CLAUSES
@@ -2012,6 +2250,11 @@ assign_forced (PS * ps, Lit * lit, Cls * reason)
     }
   else
 #endif
+  if (ISCRDREASON (reason))
+    {
+      /* DO NOTHING */
+    }
+  else
     {
       assert (!reason->locked);
       reason->locked = 1;
@@ -2276,6 +2519,32 @@ write_rup_header (PS * ps, FILE * file)
   fflush (file);
 }
 
+/* Pass a learned clause to the export call back, if it is short enough
+ * or has a small enough glue.  Binary clauses have no glue stored.
+ */
+static void
+export_clause (PS * ps, Cls * c)
+{
+  unsigned glue;
+  Lit **p, **eol;
+
+  glue = c->size <= 2 ? c->size : c->glue;
+  if ((int) c->size > ps->export.maxsize && glue > ps->export.maxglue)
+    return;
+
+  ps->exphead = ps->exported;
+  eol = end_of_lits (c);
+  for (p = c->lits; p <= eol; p++)
+    {
+      if (ps->exphead == ps->eoexp)
+        ENLARGE (ps->exported, ps->exphead, ps->eoexp);
+      *ps->exphead++ = (p < eol) ? LIT2INT (*p) : 0;
+    }
+
+  ps->exports++;
+  ps->export.function (ps->export.state, ps->exported, (int) c->size, glue);
+}
+
 static Cls *
 add_simplified_clause (PS * ps, int learned)
 {
@@ -2553,6 +2822,8 @@ REENTER:
 
           assert (other->val == FALSE);
           reason = LIT2REASON (NOTLIT (other));
+          if (res == &ps->impl)
+            resetimpl (ps);     /* since 'assign_forced' sets it again */
         }
 #endif
       assign_forced (ps, lit, reason);
@@ -2572,6 +2843,9 @@ REENTER:
   if (!learned && !num_true && num_undef)
     incjwh (ps, res);
 
+  if (learned && ps->export.function && !ps->importing)
+    export_clause (ps, res);
+
 #ifdef NO_BINARY_CLAUSES
   if (res == &ps->impl)
     resetimpl (ps);
@@ -2647,6 +2921,454 @@ simplify_and_add_original_clause (PS * ps)
     }
 }
 
+/* Add the clauses returned by the import call back as learned clauses.
+ * This happens on decision level zero only, such that literals fixed to
+ * false can simply be dropped, and clauses with a literal fixed to true
+ * are skipped.  Returns the number of clauses added.
+ */
+static int
+import_clauses (PS * ps)
+{
+  const int * c, * p;
+  unsigned count = 0;
+  Lit * lit;
+  int skip;
+
+  assert (!ps->LEVEL);
+  while (!ps->mtcls && (c = ps->import.function (ps->import.state)))
+    {
+      assert (ps->ahead == ps->added);
+      skip = 0;
+      for (p = c; !skip && *p; p++)
+        {
+          if (*p == INT_MIN || abs (*p) > (int) ps->max_var)
+            skip = 1;                   /* unknown variable */
+          else
+            {
+              lit = int2lit (ps, *p);
+              if (lit->val != FALSE)
+                add_lit (ps, lit);
+            }
+        }
+
+      if (skip || trivial_clause (ps))
+        {
+          ps->ahead = ps->added;
+          continue;
+        }
+
+      ps->importing = 1;
+      add_simplified_clause (ps, 1);
+      ps->importing = 0;
+      ps->imports++;
+      count++;
+    }
+
+  return count;
+}
+
+static void
+xorwatch (PS * ps, unsigned idx, Xor * x)
+{
+  Xws * w;
+
+  assert (idx < ps->szxws);
+  w = ps->xws + idx;
+  if (w->top == w->end)
+    ENLARGE (w->start, w->top, w->end);
+
+  *w->top++ = x;
+}
+
+/* Add the xor constraint of the literals in 'added', i.e. an odd number of
+ * them has to be true.  This happens on decision level zero, such that
+ * fixed variables can be substituted.  Variables occurring twice cancel
+ * out.  Constraints with less than three variables are added as clauses.
+ */
+static void
+add_xor (PS * ps)
+{
+  unsigned rhs, size, i;
+  Lit ** p, ** q, * lit, * a, * b;
+  Var * v;
+  Xor * x;
+
+  assert (!ps->LEVEL);
+
+  rhs = 1;
+  for (p = ps->added; p < ps->ahead; p++)
+    {
+      lit = *p;
+      v = LIT2VAR (lit);
+      if (lit->val != UNDEF)
+        rhs ^= (lit->val == TRUE);
+      else
+        {
+          rhs ^= (LIT2SGN (lit) < 0);
+          v->mark ^= 1;
+        }
+    }
+
+  q = ps->added;
+  for (p = ps->added; p < ps->ahead; p++)
+    {
+      v = LIT2VAR (*p);
+      if (!v->mark)
+        continue;
+      v->mark = 0;
+      *q++ = VAR2LIT (v);
+    }
+
+  size = q - ps->added;
+  ps->ahead = ps->added;
+  ps->xadded++;
+
+  if (size == 0)
+    {
+      if (rhs)
+        simplify_and_add_original_clause (ps);          /* empty clause */
+    }
+  else if (size == 1)
+    {
+      lit = ps->added[0];
+      add_lit (ps, rhs ? lit : NOTLIT (lit));
+      simplify_and_add_original_clause (ps);
+    }
+  else if (size == 2)
+    {
+      a = ps->added[0];
+      b = ps->added[1];
+      add_lit (ps, a);
+      add_lit (ps, rhs ? b : NOTLIT (b));
+      simplify_and_add_original_clause (ps);
+      add_lit (ps, NOTLIT (a));
+      add_lit (ps, rhs ? NOTLIT (b) : b);
+      simplify_and_add_original_clause (ps);
+    }
+  else
+    {
+      x = new (ps, bytes_xor (size));
+      x->size = size;
+      x->rhs = rhs;
+      for (i = 0; i < size; i++)
+        x->vars[i] = LIT2IDX (ps->added[i]);
+
+      if (ps->xhead == ps->eoxors)
+        ENLARGE (ps->xors, ps->xhead, ps->eoxors);
+      *ps->xhead++ = x;
+
+      if (ps->szxws <= ps->max_var)
+        {
+          RESIZEN (ps->xws, ps->szxws, ps->max_var + 1);
+          CLRN (ps->xws + ps->szxws, ps->max_var + 1 - ps->szxws);
+          ps->szxws = ps->max_var + 1;
+        }
+
+      xorwatch (ps, x->vars[0], x);
+      xorwatch (ps, x->vars[1], x);
+    }
+}
+
+static void
+crdoccurs (PS * ps, Lit * lit, Crd * d)
+{
+  Crs * o;
+
+  assert (lit - ps->lits < ps->szcrs);
+  o = ps->crs + (lit - ps->lits);
+  if (o->top == o->end)
+    ENLARGE (o->start, o->top, o->end);
+
+  *o->top++ = d;
+}
+
+/* Add the constraint that at most 'bound' of the literals in 'added' are
+ * true.  This happens on decision level zero, where fixed literals are
+ * removed.  Constraints which can be expressed by a single clause or by
+ * units are added as clauses instead.
+ */
+static void
+add_crd (PS * ps, int bound)
+{
+  Lit ** p, ** q, * lit;
+  unsigned size, i;
+  Crd * d;
+
+  assert (!ps->LEVEL);
+
+  q = ps->added;
+  for (p = ps->added; p < ps->ahead; p++)
+    {
+      lit = *p;
+      if (lit->val == TRUE)
+        bound--;
+      else if (lit->val == UNDEF)
+        *q++ = lit;
+    }
+
+  size = q - ps->added;
+  ps->ahead = ps->added;
+  ps->cadded++;
+
+  if (bound < 0)
+    simplify_and_add_original_clause (ps);              /* empty clause */
+  else if (bound == 0)
+    {
+      for (i = 0; i < size; i++)
+        {
+          lit = ps->added[i];
+          ps->ahead = ps->added;
+          add_lit (ps, NOTLIT (lit));
+          simplify_and_add_original_clause (ps);
+        }
+    }
+  else if (size == (unsigned) bound + 1)
+    {
+      for (p = ps->added; p < q; p++)
+        *p = NOTLIT (*p);
+      ps->ahead = q;
+      simplify_and_add_original_clause (ps);
+    }
+  else if (size > (unsigned) bound + 1)
+    {
+      d = new (ps, bytes_crd (size));
+      assert (!ISCRDREASON (d) && !(3 & (Wrd) d));
+      d->size = size;
+      d->bound = bound;
+      d->count = 0;
+      for (i = 0; i < size; i++)
+        d->lits[i] = ps->added[i];
+
+      if (ps->chead == ps->eocrds)
+        ENLARGE (ps->crds, ps->chead, ps->eocrds);
+      *ps->chead++ = d;
+
+      if (ps->szcrs < 2 * (ps->max_var + 1))
+        {
+          RESIZEN (ps->crs, ps->szcrs, 2 * (ps->max_var + 1));
+          CLRN (ps->crs + ps->szcrs, 2 * (ps->max_var + 1) - ps->szcrs);
+          ps->szcrs = 2 * (ps->max_var + 1);
+        }
+
+      for (i = 0; i < size; i++)
+        crdoccurs (ps, d->lits[i], d);
+
+      if (ps->szcrdimpl <= (unsigned) bound)
+        {
+          if (ps->crdimpl)
+            {
+              ps->crdimpl->size = ps->szcrdimpl;
+              delete_clause (ps, ps->crdimpl);
+            }
+          ps->crdimpl = new_clause (ps, bound + 1, 0);
+          ps->szcrdimpl = bound + 1;
+        }
+    }
+}
+
+/* Gauss-Jordan elimination of the xor constraints, after new ones were
+ * added, which detects inconsistent constraints, and derives units and
+ * equivalences implied by their sum.  These are added as learned clauses.
+ * Happens on decision level zero, where fixed variables are substituted,
+ * and is skipped for large systems.
+ */
+static void
+gauss (PS * ps)
+{
+  unsigned nrows, ncols, nwords, r, c, i, j, k, * cols, * vars, found[2];
+  unsigned * sizes, osize, nsize;
+  unsigned long * rows, * row, * pivot, bit;
+  unsigned char * rhs, tmp;
+  Lit * lit;
+  Xor * x;
+
+  assert (!ps->LEVEL);
+  assert (!ps->mtcls);
+
+  nrows = ps->xhead - ps->xors;
+  ps->xgauss = nrows;
+
+  /* Columns are ordered by variable index, such that pivots are taken
+   * from the variables with smaller indices (rather than from auxiliary
+   * ones, which are usually added later), the same way every time.
+   */
+  NEWN (cols, ps->max_var + 1);
+  CLRN (cols, ps->max_var + 1);
+  for (i = 0; i < nrows; i++)
+    {
+      x = ps->xors[i];
+      for (j = 0; j < x->size; j++)
+        if (ps->lits[2 * x->vars[j]].val == UNDEF)
+          cols[x->vars[j]] = 1;
+    }
+  ncols = 0;
+  for (i = 1; i <= ps->max_var; i++)
+    if (cols[i])
+      cols[i] = ++ncols;
+
+  nwords = (ncols + GAUSSWRDSZ - 1) / GAUSSWRDSZ;
+  if (!nwords ||
+      (double) nrows * nwords * ncols > GAUSSLIMIT)
+    {
+      DELETEN (cols, ps->max_var + 1);
+      return;
+    }
+
+  NEWN (vars, ncols + 1);
+  for (i = 1; i <= ps->max_var; i++)
+    if (cols[i])
+      vars[cols[i] - 1] = i;
+
+  NEWN (rows, nrows * nwords);
+  CLRN (rows, nrows * nwords);
+  NEWN (rhs, nrows);
+  for (i = 0; i < nrows; i++)
+    {
+      x = ps->xors[i];
+      row = rows + i * nwords;
+      rhs[i] = x->rhs;
+      for (j = 0; j < x->size; j++)
+        {
+          lit = ps->lits + 2 * x->vars[j];
+          if (lit->val == UNDEF)
+            {
+              c = cols[x->vars[j]] - 1;
+              row[c / GAUSSWRDSZ] |= 1ul << (c % GAUSSWRDSZ);
+            }
+          else
+            rhs[i] ^= (lit->val == TRUE);
+        }
+    }
+
+  r = 0;
+  for (c = 0; c < ncols && r < nrows; c++)
+    {
+      bit = 1ul << (c % GAUSSWRDSZ);
+      for (i = r; i < nrows; i++)
+        if (rows[i * nwords + c / GAUSSWRDSZ] & bit)
+          break;
+
+      if (i == nrows)
+        continue;
+
+      if (i != r)
+        {
+          for (k = 0; k < nwords; k++)
+            {
+              bit = rows[i * nwords + k];
+              rows[i * nwords + k] = rows[r * nwords + k];
+              rows[r * nwords + k] = bit;
+            }
+          tmp = rhs[i];
+          rhs[i] = rhs[r];
+          rhs[r] = tmp;
+          bit = 1ul << (c % GAUSSWRDSZ);
+        }
+
+      pivot = rows + r * nwords;
+      for (i = 0; i < nrows; i++)
+        {
+          row = rows + i * nwords;
+          if (i == r || !(row[c / GAUSSWRDSZ] & bit))
+            continue;
+          for (k = c / GAUSSWRDSZ; k < nwords; k++)
+            row[k] ^= pivot[k];
+          rhs[i] ^= rhs[r];
+        }
+      r++;
+    }
+
+  osize = nsize = 0;
+  for (i = 0; i < nrows; i++)
+    osize += ps->xors[i]->size;
+
+  NEWN (sizes, nrows);
+  for (i = 0; i < nrows && !ps->mtcls; i++)
+    {
+      row = rows + i * nwords;
+      k = 0;
+      for (c = 0; c < ncols; c++)
+        if (row[c / GAUSSWRDSZ] & (1ul << (c % GAUSSWRDSZ)))
+          {
+            if (k < 2)
+              found[k] = vars[c];
+            k++;
+          }
+      sizes[i] = k;
+      if (k > 2)
+        {
+          nsize += k;
+          continue;
+        }
+
+      assert (ps->ahead == ps->added);
+      if (k == 0 && !rhs[i])
+        continue;
+
+      if (k == 0)
+        add_simplified_clause (ps, 1);                  /* empty clause */
+      else if (k == 1)
+        {
+          lit = ps->lits + 2 * found[0];
+          add_lit (ps, rhs[i] ? lit : NOTLIT (lit));
+          add_simplified_clause (ps, 1);
+        }
+      else
+        {
+          lit = ps->lits + 2 * found[1];
+          add_lit (ps, ps->lits + 2 * found[0]);
+          add_lit (ps, rhs[i] ? lit : NOTLIT (lit));
+          add_simplified_clause (ps, 1);
+          add_lit (ps, NOTLIT (ps->lits + 2 * found[0]));
+          add_lit (ps, rhs[i] ? NOTLIT (lit) : lit);
+          add_simplified_clause (ps, 1);
+        }
+      ps->xgaussed++;
+    }
+
+  /* In the reduced system each pivot only occurs in its own row, and is
+   * forced as soon as the other variables of that row are assigned, which
+   * propagates much more than the original constraints.  So these are
+   * replaced by the rows, unless the rows got much longer.
+   */
+  if (!ps->mtcls && nsize <= 2 * osize)
+    {
+      for (i = 0; i < ps->szxws; i++)
+        ps->xws[i].top = ps->xws[i].start;
+
+      for (i = 0; i < nrows; i++)
+        delete (ps, ps->xors[i], bytes_xor (ps->xors[i]->size));
+
+      ps->xhead = ps->xors;
+      for (i = 0; i < nrows; i++)
+        {
+          if (sizes[i] <= 2)
+            continue;
+
+          x = new (ps, bytes_xor (sizes[i]));
+          x->size = sizes[i];
+          x->rhs = rhs[i];
+          row = rows + i * nwords;
+          k = 0;
+          for (c = 0; c < ncols; c++)
+            if (row[c / GAUSSWRDSZ] & (1ul << (c % GAUSSWRDSZ)))
+              x->vars[k++] = vars[c];
+          assert (k == x->size);
+
+          *ps->xhead++ = x;
+          xorwatch (ps, x->vars[0], x);
+          xorwatch (ps, x->vars[1], x);
+        }
+      ps->xgauss = ps->xhead - ps->xors;
+    }
+
+  DELETEN (sizes, nrows);
+  DELETEN (rhs, nrows);
+  DELETEN (rows, nrows * nwords);
+  DELETEN (vars, ncols + 1);
+  DELETEN (cols, ps->max_var + 1);
+}
+
 #ifndef NADC
 
 static void
@@ -2879,6 +3601,21 @@ fix_heap_rnks (PS * ps, long delta)
     *p += delta;
 }
 
+static void
+fix_crd_lits (PS * ps, long delta)
+{
+  Lit ** p, ** eol;
+  Crd ** q, * d;
+
+  for (q = ps->crds; q < ps->chead; q++)
+    {
+      d = *q;
+      eol = d->lits + d->size + d->count;
+      for (p = d->lits; p < eol; p++)
+        *p += delta;
+    }
+}
+
 #ifndef NADC
 
 static void
@@ -2924,6 +3661,7 @@ enlarge (PS * ps, unsigned new_size_vars)
       fix_added_lits (ps, lits_delta);
       fix_assumed_lits (ps, lits_delta);
       fix_cls_lits (ps, lits_delta);
+      fix_crd_lits (ps, lits_delta);
 #ifdef NO_BINARY_CLAUSES
       fix_impl_lits (ps, lits_delta);
 #endif
@@ -2964,7 +3702,11 @@ unassign (PS * ps, Lit * lit)
     }
   else
 #endif
-  if (reason)
+  if (ISCRDREASON (reason))
+    {
+      /* DO NOTHING */
+    }
+  else if (reason)
     {
       assert (reason->locked);
       reason->locked = 0;
@@ -2973,6 +3715,8 @@ unassign (PS * ps, Lit * lit)
           assert (ps->llocked > 0);
           ps->llocked--;
         }
+      if (reason->xreason)
+        delete_clause (ps, reason);
     }
 
   lit->val = UNDEF;
@@ -3031,8 +3775,9 @@ static Cls *
 var2reason (PS * ps, Var * var)
 {
   Cls * res = var->reason;
+  Lit * this;
 #ifdef NO_BINARY_CLAUSES
-  Lit * this, * other;
+  Lit * other;
   if (ISLITREASON (res))
     {
       this = VAR2LIT (var);
@@ -3044,9 +3789,15 @@ var2reason (PS * ps, Var * var)
       assert (this->val == TRUE);
       res = setimpl (ps, NOTLIT (other), this);
     }
-#else
-  (void) ps;
 #endif
+  if (ISCRDREASON (res))
+    {
+      this = VAR2LIT (var);
+      if (this->val == FALSE)
+        this = NOTLIT (this);
+
+      res = crd2impl (ps, this, REASON2CRD (res));
+    }
   return res;
 }
 
@@ -3057,6 +3808,29 @@ mark_clause_to_be_collected (Cls * c)
   c->collect = 1;
 }
 
+/* Pop 'lit' from the stacks of the cardinality constraints containing it.
+ * Since the trail is undone in reverse order, it is on top of them.
+ */
+static void
+uncount_crds (PS * ps, Lit * lit)
+{
+  unsigned pos = lit - ps->lits;
+  Crd ** p, * d;
+  Crs * o;
+
+  if (pos >= ps->szcrs)
+    return;
+
+  o = ps->crs + pos;
+  for (p = o->start; p < o->top; p++)
+    {
+      d = *p;
+      assert (d->count > 0);
+      d->count--;
+      assert (d->lits[d->size + d->count] == lit);
+    }
+}
+
 static void
 undo (PS * ps, unsigned new_level)
 {
@@ -3073,12 +3847,17 @@ undo (PS * ps, unsigned new_level)
           break;
         }
 
+      if (ps->thead < ps->ttailcrd)
+        uncount_crds (ps, lit);
+
       unassign (ps, lit);
     }
 
   ps->LEVEL = new_level;
   ps->ttail = ps->thead;
   ps->ttail2 = ps->thead;
+  ps->ttailxor = ps->thead;
+  ps->ttailcrd = ps->thead;
 #ifndef NADC
   ps->ttailado = ps->thead;
 #endif
@@ -3087,6 +3866,10 @@ undo (PS * ps, unsigned new_level)
   if (ps->conflict == &ps->cimpl)
     resetcimpl (ps);
 #endif
+  if (ps->conflict && ps->conflict == ps->xorconflict)
+    resetxorconflict (ps);
+  if (ps->conflict && ps->conflict == ps->crdconflict)
+    resetcrdconflict (ps);
 #ifndef NADC
   if (ps->conflict && ps->conflict == ps->adoconflict)
     resetadoconflict (ps);
@@ -3138,6 +3921,45 @@ original_clauses_satisfied (PS * ps)
     }
 }
 
+static void
+xors_satisfied (PS * ps)
+{
+  unsigned parity, i;
+  Xor **p, *x;
+
+  for (p = ps->xors; p < ps->xhead; p++)
+    {
+      x = *p;
+      parity = x->rhs;
+      for (i = 0; i < x->size; i++)
+        {
+          assert (ps->lits[2 * x->vars[i]].val != UNDEF);
+          parity ^= (ps->lits[2 * x->vars[i]].val == TRUE);
+        }
+      assert (!parity);
+    }
+}
+
+static void
+crds_satisfied (PS * ps)
+{
+  unsigned count, i;
+  Crd **p, *d;
+
+  for (p = ps->crds; p < ps->chead; p++)
+    {
+      d = *p;
+      count = 0;
+      for (i = 0; i < d->size; i++)
+        {
+          assert (d->lits[i]->val != UNDEF);
+          count += (d->lits[i]->val == TRUE);
+        }
+      assert (count <= d->bound);
+      assert (count == d->count);
+    }
+}
+
 static void
 assumptions_satisfied (PS * ps)
 {
@@ -3412,6 +4234,12 @@ bcp_queue_is_empty (PS * ps)
   if (ps->ttail2 != ps->thead)
     return 0;
 
+  if (ps->ttailxor != ps->thead)
+    return 0;
+
+  if (ps->ttailcrd != ps->thead)
+    return 0;
+
 #ifndef NADC
   if (ps->ttailado != ps->thead)
     return 0;
@@ -3842,6 +4670,7 @@ fanalyze (PS * ps)
 #ifdef NO_BINARY_CLAUSES
   if (!ISLITREASON (reason))
 #endif
+  if (!ISCRDREASON (reason))
     {
       assert (reason->locked);
       reason->locked = 0;
@@ -3850,6 +4679,8 @@ fanalyze (PS * ps)
           assert (ps->llocked > 0);
           ps->llocked--;
         }
+      if (reason->xreason)
+        delete_clause (ps, reason);
     }
 
 #ifdef NO_BINARY_CLAUSES
@@ -4317,6 +5148,177 @@ propado (PS * ps, Var * v)
 
 #endif
 
+/* Return a new clause of the literals of the variables of 'x' which are
+ * false, and of the (undefined) literal 'lit' if given, which serves as
+ * reason for assigning 'lit' or as conflict clause.  These clauses are
+ * not connected and deleted when their literals are unassigned.
+ */
+static Cls *
+xor2clause (PS * ps, Xor * x, Lit * lit)
+{
+  Lit ** q, * other;
+  unsigned i;
+  Cls * res;
+
+  res = new_clause (ps, x->size, 0);
+  res->xreason = 1;
+  q = res->lits;
+  if (lit)
+    *q++ = lit;
+  for (i = 0; i < x->size; i++)
+    {
+      other = ps->lits + 2 * x->vars[i];
+      if (other->val == UNDEF)
+        continue;
+      *q++ = other->val == FALSE ? other : NOTLIT (other);
+    }
+  assert (q == ENDOFCLS (res));
+  return res;
+}
+
+/* Propagate the assignment of 'v' to the xor constraints watching it.
+ * Watches move to unassigned variables, and if there is none left, the
+ * other watched variable is forced, or all are assigned and the parity
+ * is checked.
+ */
+static void
+propxor (PS * ps, Var * v)
+{
+  unsigned idx = v - ps->vars, i, tmp, parity, * vars;
+  Xor ** p, ** q, ** eow, * x;
+  Lit * lit;
+  Cls * c;
+  Xws * w;
+
+  if (idx >= ps->szxws)
+    return;
+
+  w = ps->xws + idx;
+  q = w->start;
+  eow = w->top;
+  for (p = w->start; p < eow; p++)
+    {
+      x = *q++ = *p;
+      if (ps->conflict)
+        continue;
+
+      ps->visits++;
+      vars = x->vars;           /* of length x->size, see 'Xor' */
+      if (vars[0] != idx)
+        {
+          assert (vars[1] == idx);
+          vars[1] = vars[0];
+          vars[0] = idx;
+        }
+
+      for (i = 2; i < x->size; i++)
+        if (ps->lits[2 * vars[i]].val == UNDEF)
+          break;
+
+      if (i < x->size)          /* found new watch */
+        {
+          tmp = vars[i];
+          vars[i] = idx;
+          vars[0] = tmp;
+          xorwatch (ps, tmp, x);
+          q--;
+          continue;
+        }
+
+      parity = x->rhs;
+      for (i = 0; i < x->size; i++)
+        parity ^= (ps->lits[2 * vars[i]].val == TRUE);
+
+      lit = ps->lits + 2 * vars[1];
+      if (lit->val == UNDEF)
+        {
+          if (!parity)
+            lit = NOTLIT (lit);
+          c = xor2clause (ps, x, lit);
+          ps->xorprops++;
+          assign_forced (ps, lit, c);
+          if (!ps->LEVEL)       /* replaced by a learned unit */
+            {
+              assert (LIT2VAR (lit)->reason != c);
+              delete_clause (ps, c);
+            }
+        }
+      else if (parity)
+        {
+          assert (!ps->xorconflict);
+          ps->xorconflict = ps->conflict = xor2clause (ps, x, 0);
+          ps->xorconflicts++;
+        }
+    }
+  w->top = q;
+}
+
+/* Count the assignment of 'lit' to true in the cardinality constraints
+ * containing it.  If one of them reaches its bound the remaining literals
+ * are forced to false, and beyond its bound it is in conflict.  Counting
+ * continues after a conflict, such that 'undo' can simply pop 'lit' from
+ * all of them.
+ */
+static void
+propcrd (PS * ps, Lit * lit)
+{
+  unsigned pos = lit - ps->lits;
+  Lit ** p, ** q, ** eol, * other;
+  Crd ** r, * d;
+  Cls * reason;
+  Crs * o;
+
+  assert (lit->val == TRUE);
+
+  if (pos >= ps->szcrs)
+    return;
+
+  o = ps->crs + pos;
+  for (r = o->start; r < o->top; r++)
+    {
+      d = *r;
+      assert (d->count < d->size);
+      d->lits[d->size + d->count++] = lit;
+
+      if (ps->conflict)
+        continue;
+
+      ps->visits++;
+      if (d->count > d->bound)
+        {
+          assert (!ps->crdconflict);
+          reason = new_clause (ps, d->bound + 1, 0);
+          reason->xreason = 1;
+          q = reason->lits;
+          eol = d->lits + d->size + d->bound + 1;
+          for (p = d->lits + d->size; p < eol; p++)
+            *q++ = NOTLIT (*p);
+          ps->crdconflict = ps->conflict = reason;
+          ps->crdconflicts++;
+        }
+      else if (d->count == d->bound)
+        {
+#ifdef NO_BINARY_CLAUSES
+          if (d->bound == 1)
+            reason = LIT2REASON (lit);  /* binary clause '-lit -other' */
+          else
+#endif
+            reason = CRD2REASON (d);
+
+          eol = d->lits + d->size;
+          for (p = d->lits; p < eol; p++)
+            {
+              other = *p;
+              if (other->val != UNDEF)
+                continue;
+
+              ps->crdprops++;
+              assign_forced (ps, NOTLIT (other), reason);
+            }
+        }
+    }
+}
+
 static void
 bcp (PS * ps)
 {
@@ -4333,10 +5335,28 @@ bcp (PS * ps)
           props++;
           prop2 (ps, NOTLIT (*ps->ttail2++));
         }
-      else if (ps->ttail < ps->thead)   /* unit clauses or clauses with length > 2 */
+      else if (ps->ttail < ps->thead)   /* unit clauses or clauses with length > 2 */
+        {
+          if (ps->conflict) break;
+          propl (ps, NOTLIT (*ps->ttail++));
+          if (ps->conflict) break;
+        }
+      else if (ps->ttailxor < ps->thead)        /* xor constraints */
+        {
+          if (ps->conflict) break;
+          if (ps->xhead == ps->xors)
+            ps->ttailxor = ps->thead;
+          else
+            propxor (ps, LIT2VAR (*ps->ttailxor++));
+          if (ps->conflict) break;
+        }
+      else if (ps->ttailcrd < ps->thead)        /* cardinality constraints */
         {
           if (ps->conflict) break;
-          propl (ps, NOTLIT (*ps->ttail++));
+          if (ps->chead == ps->crds)
+            ps->ttailcrd = ps->thead;
+          else
+            propcrd (ps, *ps->ttailcrd++);
           if (ps->conflict) break;
         }
 #ifndef NADC
@@ -4857,7 +5877,7 @@ inc_lrestart (PS * ps, int skip)
 {
   unsigned delta;
 
-  delta = 100 * luby (++ps->lubycnt);
+  delta = ps->restartunit * luby (++ps->lubycnt);
   ps->lrestart = ps->conflicts + delta;
 
   if (ps->waslubymaxdelta)
@@ -4882,8 +5902,8 @@ init_restart (PS * ps)
   /* TODO: why is it better in incremental usage to have smaller initial
    * outer restart interval?
    */
-  ps->ddrestart = ps->calls > 1 ? MINRESTART : 1000;
-  ps->drestart = MINRESTART;
+  ps->ddrestart = ps->calls > 1 ? ps->restartunit : 1000;
+  ps->drestart = ps->restartunit;
   ps->lrestart = ps->conflicts + ps->drestart;
 #else
   ps->lubycnt = 0;
@@ -4932,7 +5952,7 @@ restart (PS * ps)
     {
       kind = skip ? 'N' : 'R';
       inc_ddrestart (ps);
-      ps->drestart = MINRESTART;
+      ps->drestart = ps->restartunit;
     }
   else  if (skip)
     {
@@ -5377,7 +6397,8 @@ simplify (PS * ps, int forced)
           else
             *ps->ttail++ = lit;
         }
-      ps->ttail2 = ps->thead = ps->ttail;
+      assert (ps->ttailcrd == ps->thead);
+      ps->ttail2 = ps->ttailxor = ps->ttailcrd = ps->thead = ps->ttail;
 
       for (q = ps->cils; q != ps->cilshead; q++)
         {
@@ -5468,7 +6489,7 @@ iteration (PS * ps)
   ps->iterations++;
   report (ps, 2, 'i');
 #ifdef NLUBY
-  ps->drestart = MINRESTART;
+  ps->drestart = ps->restartunit;
   ps->lrestart = ps->conflicts + ps->drestart;
 #else
   init_restart (ps);
@@ -5899,6 +6920,10 @@ sat (PS * ps, int l)
 {
   int count = 0, backtracked;
 
+  if (!ps->LEVEL && !ps->conflict && !ps->mtcls &&
+      ps->xgauss < ps->xhead - ps->xors)
+    gauss (ps);
+
   if (!ps->conflict)
     bcp (ps);
 
@@ -5949,6 +6974,8 @@ sat (PS * ps, int l)
 SATISFIED:
 #ifndef NDEBUG
           original_clauses_satisfied (ps);
+          xors_satisfied (ps);
+          crds_satisfied (ps);
           assumptions_satisfied (ps);
 #endif
           return PICOSAT_SATISFIABLE;
@@ -6002,6 +7029,13 @@ SATISFIED:
       if (ps->conflicts >= ps->lrestart && ps->LEVEL > 2)
         restart (ps);
 
+      if (!ps->LEVEL && ps->import.function && import_clauses (ps))
+        {
+          if (ps->mtcls)
+            return PICOSAT_UNSATISFIABLE;
+          continue;             /* propagate imported clauses first */
+        }
+
       decide (ps);
       if (ps->failed_assumption)
         return PICOSAT_UNSATISFIABLE;
@@ -6495,6 +7529,10 @@ reset_incremental_usage (PS * ps)
       if (ps->conflict == ps->adoconflict)
         resetadoconflict (ps);
 #endif
+      if (ps->conflict == ps->xorconflict)
+        resetxorconflict (ps);
+      if (ps->conflict == ps->crdconflict)
+        resetcrdconflict (ps);
       ps->conflict = 0;
     }
 
@@ -6857,6 +7895,8 @@ picosat_add (PS * ps, int int_lit)
   ABORTIF (ps->addingtoado,
            "API usage: 'picosat_add' and 'picosat_add_ado_lit' mixed");
 #endif
+  ABORTIF (ps->addingtoxor,
+           "API usage: 'picosat_add' and 'picosat_add_xor_lit' mixed");
   if (ps->state != READY)
     reset_incremental_usage (ps);
 
@@ -6904,6 +7944,107 @@ picosat_add_lits (PS * ps, int * lits)
   return picosat_add (ps, 0);
 }
 
+int
+picosat_add_clauses (PS * ps, const int * lits, size_t n)
+{
+  unsigned maxidx, len, maxlen, nclauses;
+  const int * p, * eol;
+  int res = ps->oadded;
+  int lit, idx;
+
+  if (ps->measurealltimeinlib)
+    enter (ps);
+  else
+    check_ready (ps);
+
+#ifndef NADC
+  ABORTIF (ps->addingtoado,
+           "API usage: 'picosat_add_clauses' and 'picosat_add_ado_lit' mixed");
+#endif
+  ABORTIF (ps->addingtoxor,
+           "API usage: 'picosat_add_clauses' and 'picosat_add_xor_lit' mixed");
+  ABORTIF (n && lits[n - 1],
+           "API usage: clauses passed to 'picosat_add_clauses' not terminated");
+
+  /* One pass over the literals checks them and determines the number
+   * of variables, clauses and the maximal clause length, such that all
+   * stacks and tables can be allocated at once.
+   */
+  maxidx = nclauses = maxlen = 0;
+  len = ps->ahead - ps->added;  /* continue a clause started with 'add' */
+  eol = lits + n;
+  for (p = lits; p < eol; p++)
+    {
+      lit = *p;
+      if (!lit)
+        {
+          if (len > maxlen)
+            maxlen = len;
+          len = 0;
+          nclauses++;
+          continue;
+        }
+
+      ABORTIF (lit == INT_MIN, "API usage: INT_MIN literal");
+      idx = abs (lit);
+      if ((unsigned) idx > maxidx)
+        maxidx = idx;
+
+      if (ps->internals && (unsigned) idx <= ps->max_var)
+        ABORTIF (ps->vars[idx].internal,
+                 "API usage: trying to import invalid literal");
+      len++;
+    }
+
+  ABORTIF (maxidx > ps->max_var && ps->CLS != ps->clshead,
+           "API usage: new variable index after 'picosat_push'");
+  ABORTIF (ps->rup && ps->rupstarted &&
+           ps->oadded + nclauses > (unsigned)ps->rupclauses,
+           "API usage: adding too many clauses after RUP header written");
+
+  if (ps->state != READY)
+    reset_incremental_usage (ps);
+
+  if (maxidx > ps->max_var)
+    {
+      if (ps->size_vars < maxidx + 1)
+        enlarge (ps, maxidx + 1);
+
+      while (ps->max_var < maxidx)
+        inc_max_var (ps);
+    }
+
+  /* One more slot in 'added' for the negated context literal.
+   */
+  RESERVE (ps->added, ps->ahead, ps->eoa, maxlen + 1);
+  RESERVE (ps->oclauses, ps->ohead, ps->eoo, nclauses);
+  if (ps->EOL == ps->oclauses)
+    ENLARGE (ps->oclauses, ps->ohead, ps->eoo);   /* see 'add_simplified' */
+
+  if (ps->saveorig)
+    {
+      RESERVE (ps->soclauses, ps->sohead, ps->eoso, n);
+      memcpy (ps->sohead, lits, n * sizeof *lits);
+      ps->sohead += n;
+    }
+
+  for (p = lits; p < eol; p++)
+    {
+      if ((lit = *p))
+        {
+          assert (ps->ahead < ps->eoa);
+          *ps->ahead++ = int2lit (ps, lit);
+        }
+      else
+        simplify_and_add_original_clause (ps);
+    }
+
+  if (ps->measurealltimeinlib)
+    leave (ps);
+
+  return res;
+}
+
 void
 picosat_add_ado_lit (PS * ps, int external_lit)
 {
@@ -6941,6 +8082,87 @@ picosat_add_ado_lit (PS * ps, int external_lit)
 #endif
 }
 
+void
+picosat_add_xor_lit (PS * ps, int external_lit)
+{
+  Lit * internal_lit;
+
+  if (ps->measurealltimeinlib)
+    enter (ps);
+  else
+    check_ready (ps);
+
+  if (ps->state != READY)
+    reset_incremental_usage (ps);
+
+  ABORTIF (!ps->addingtoxor && ps->ahead > ps->added,
+           "API usage: 'picosat_add' and 'picosat_add_xor_lit' mixed");
+#ifndef NADC
+  ABORTIF (ps->addingtoado,
+           "API usage: 'picosat_add_ado_lit' and 'picosat_add_xor_lit' mixed");
+#endif
+  ABORTIF (ps->CLS != ps->clshead,
+           "API usage: xor constraints can not be added in a context");
+#ifdef TRACE
+  ABORTIF (ps->trace, "API usage: xor constraints with trace generation");
+#endif
+  ABORTIF (ps->rup, "API usage: xor constraints with RUP file");
+  ABORTIF (ps->saveorig,
+           "API usage: xor constraints with saved original clauses");
+
+  if (external_lit)
+    {
+      ps->addingtoxor = 1;
+      internal_lit = import_lit (ps, external_lit, 1);
+      add_lit (ps, internal_lit);
+    }
+  else
+    {
+      ps->addingtoxor = 0;
+      add_xor (ps);
+    }
+
+  if (ps->measurealltimeinlib)
+    leave (ps);
+}
+
+void
+picosat_add_atmost (PS * ps, const int * lits, int n, int bound)
+{
+  int i;
+
+  if (ps->measurealltimeinlib)
+    enter (ps);
+  else
+    check_ready (ps);
+
+  if (ps->state != READY)
+    reset_incremental_usage (ps);
+
+  ABORTIF (ps->ahead > ps->added,
+           "API usage: 'picosat_add_atmost' in the middle of a clause");
+  ABORTIF (n < 0, "API usage: negative number of literals");
+  ABORTIF (ps->CLS != ps->clshead,
+           "API usage: cardinality constraints can not be added in a context");
+#ifdef TRACE
+  ABORTIF (ps->trace,
+           "API usage: cardinality constraints with trace generation");
+#endif
+  ABORTIF (ps->rup, "API usage: cardinality constraints with RUP file");
+  ABORTIF (ps->saveorig,
+           "API usage: cardinality constraints with saved original clauses");
+
+  for (i = 0; i < n; i++)
+    {
+      ABORTIF (!lits[i], "API usage: zero literal in cardinality constraint");
+      add_lit (ps, import_lit (ps, lits[i], 1));
+    }
+  add_crd (ps, bound);
+
+  if (ps->measurealltimeinlib)
+    leave (ps);
+}
+
 static void
 assume (PS * ps, Lit * lit)
 {
@@ -7122,34 +8344,11 @@ picosat_assume (PS * ps, int int_lit)
     leave (ps);
 }
 
-int
-picosat_sat (PS * ps, int l)
+static int
+sat_result (PS * ps, int res)
 {
-  int res;
   char ch;
 
-  enter (ps);
-
-  ps->calls++;
-  LOG ( fprintf (ps->out, "%sSTART call %u\n", ps->prefix, ps->calls));
-
-  if (ps->added < ps->ahead)
-    {
-#ifndef NADC
-      if (ps->addingtoado)
-        ABORT ("API usage: incomplete all different constraint");
-      else
-#endif
-        ABORT ("API usage: incomplete clause");
-    }
-
-  if (ps->state != READY)
-    reset_incremental_usage (ps);
-
-  assume_contexts (ps);
-
-  res = sat (ps, l);
-
   assert (ps->state == READY);
 
   switch (res)
@@ -7182,6 +8381,100 @@ picosat_sat (PS * ps, int l)
   return res;
 }
 
+int
+picosat_sat (PS * ps, int l)
+{
+  int res;
+
+  enter (ps);
+
+  ps->calls++;
+  LOG ( fprintf (ps->out, "%sSTART call %u\n", ps->prefix, ps->calls));
+
+  if (ps->added < ps->ahead)
+    {
+#ifndef NADC
+      if (ps->addingtoado)
+        ABORT ("API usage: incomplete all different constraint");
+      else
+#endif
+      if (ps->addingtoxor)
+        ABORT ("API usage: incomplete xor constraint");
+      else
+        ABORT ("API usage: incomplete clause");
+    }
+
+  if (ps->state != READY)
+    reset_incremental_usage (ps);
+
+  assume_contexts (ps);
+
+  res = sat (ps, l);
+
+  return sat_result (ps, res);
+}
+
+int
+picosat_next_model (PS * ps, int level, int l)
+{
+  const int * decs;
+  int res, n, i;
+
+  enter (ps);
+  check_sat_state (ps);
+  ABORTIF (ps->mtcls, "API usage: next model after empty clause generated");
+  ABORTIF (ps->added < ps->ahead, "API usage: incomplete clause");
+  ABORTIF (ps->als < ps->alshead,
+           "API usage: can not enumerate models under assumptions");
+  ABORTIF (ps->CLS < ps->clshead,
+           "API usage: can not enumerate models in a context");
+#ifdef TRACE
+  ABORTIF (ps->trace, "API usage: model enumeration with trace generation");
+#endif
+  ABORTIF (ps->rup, "API usage: model enumeration with RUP file");
+
+  ps->calls++;
+  LOG ( fprintf (ps->out, "%sSTART next model call %u\n", ps->prefix, ps->calls));
+
+  decs = picosat_decision_literals (ps);
+  for (n = 0; decs[n]; n++)
+    ;
+  if (level < 0 || level > n)
+    level = n;
+
+  /* Go back to the level before the last blocked decision, on which the
+   * clause of the negated decisions is unit and flips this decision.
+   */
+  undo (ps, level ? level - 1 : 0);
+
+  reset_partial (ps);
+  ps->saved_flips = ps->flips;
+  ps->min_flipped = UINT_MAX;
+  ps->saved_max_var = ps->max_var;
+  ps->state = READY;
+
+  for (i = 0; i < level; i++)
+    add_lit (ps, int2lit (ps, -decs[i]));
+  add_simplified_clause (ps, 0);
+
+  /* Unlike on the top level, conflicts can occur before the search.
+   */
+  while (!ps->mtcls)
+    {
+      bcp (ps);
+      if (!ps->conflict)
+        break;
+      backtrack (ps);
+    }
+
+  if (ps->mtcls)
+    res = PICOSAT_UNSATISFIABLE;
+  else
+    res = sat (ps, l);
+
+  return sat_result (ps, res);
+}
+
 int
 picosat_res (PS * ps)
 {
@@ -7216,6 +8509,53 @@ picosat_deref (PS * ps, int int_lit)
   return 0;
 }
 
+const int *
+picosat_decision_literals (PS * ps)
+{
+  Lit ** p, * lit;
+  Var * v;
+
+  check_ready (ps);
+  check_sat_state (ps);
+  ABORTIF (ps->mtcls, "API usage: decisions after empty clause generated");
+
+  ps->decshead = ps->decs;
+  for (p = ps->trail; p < ps->thead; p++)
+    {
+      lit = *p;
+      v = LIT2VAR (lit);
+      if (!v->level || v->reason)
+        continue;
+      if (ps->decshead == ps->eodecs)
+        ENLARGE (ps->decs, ps->decshead, ps->eodecs);
+      *ps->decshead++ = LIT2INT (lit);
+    }
+  if (ps->decshead == ps->eodecs)
+    ENLARGE (ps->decs, ps->decshead, ps->eodecs);
+  *ps->decshead++ = 0;
+  return ps->decs;
+}
+
+int
+picosat_deref_level (PS * ps, int int_lit)
+{
+  Lit *lit;
+
+  check_ready (ps);
+  check_sat_state (ps);
+  ABORTIF (!int_lit, "API usage: can not deref zero literal");
+  ABORTIF (ps->mtcls, "API usage: deref after empty clause generated");
+
+  if (abs (int_lit) > (int) ps->max_var)
+    return -1;
+
+  lit = int2lit (ps, int_lit);
+  if (lit->val == UNDEF)
+    return -1;
+
+  return (int) LIT2VAR (lit)->level;
+}
+
 int
 picosat_deref_toplevel (PS * ps, int int_lit)
 {
@@ -8042,6 +9382,19 @@ picosat_stats (PS * ps)
 #ifndef NADC
    fprintf (ps->out, "%s%u adc conflicts\n", ps->prefix, ps->adoconflicts);
 #endif
+  if (ps->export.function || ps->import.function)
+   fprintf (ps->out, "%s%u exported, %u imported clauses\n",
+            ps->prefix, ps->exports, ps->imports);
+  if (ps->xadded)
+   fprintf (ps->out,
+            "%s%u xor constraints, %u propagations, %u conflicts, "
+            "%u eliminated\n",
+            ps->prefix, ps->xadded, ps->xorprops, ps->xorconflicts,
+            ps->xgaussed);
+  if (ps->cadded)
+   fprintf (ps->out,
+            "%s%u cardinality constraints, %u propagations, %u conflicts\n",
+            ps->prefix, ps->cadded, ps->crdprops, ps->crdconflicts);
 #ifdef STATS
    fprintf (ps->out, "%s%llu dereferenced literals\n", ps->prefix, ps->derefs);
 #endif
@@ -8330,6 +9683,14 @@ picosat_remove_learned (PS * ps, unsigned percentage)
   leave (ps);
 }
 
+void
+picosat_set_restart_unit (PS * ps, unsigned conflicts)
+{
+  check_ready (ps);
+  ABORTIF (!conflicts, "API usage: zero restart unit");
+  ps->restartunit = conflicts;
+}
+
 void
 picosat_set_global_default_phase (PS * ps, int phase)
 {
@@ -8482,6 +9843,35 @@ void picosat_set_interrupt (PicoSAT * ps,
   ps->interrupt.function = interrupted;
 }
 
+void picosat_set_clause_export (PicoSAT * ps,
+                                void * external_state,
+                                void (*export)(void * external_state,
+                                               const int * lits,
+                                               int size,
+                                               unsigned glue),
+                                int max_size,
+                                unsigned max_glue)
+{
+  check_ready (ps);
+  ps->export.state = external_state;
+  ps->export.function = export;
+  ps->export.maxsize = max_size;
+  ps->export.maxglue = max_glue;
+}
+
+void picosat_set_clause_import (PicoSAT * ps,
+                                void * external_state,
+                                const int * (*import)(void * external_state))
+{
+  check_ready (ps);
+#ifdef TRACE
+  ABORTIF (ps->trace, "API usage: clause import with trace generation");
+#endif
+  ABORTIF (ps->rup, "API usage: clause import with RUP file");
+  ps->import.state = external_state;
+  ps->import.function = import;
+}
+
 int
 picosat_deref_partial (PS * ps, int int_lit)
 {
@@ -8490,6 +9880,9 @@ picosat_deref_partial (PS * ps, int int_lit)
   ABORTIF (!int_lit, "API usage: can not partial deref zero literal");
   ABORTIF (ps->mtcls, "API usage: deref partial after empty clause generated");
   ABORTIF (!ps->saveorig, "API usage: 'picosat_save_original_clauses' missing");
+  ABORTIF (ps->xadded, "API usage: deref partial with xor constraints");
+  ABORTIF (ps->cadded,
+           "API usage: deref partial with cardinality constraints");
 
 #ifdef STATS
   ps->derefs++;
@@ -118,6 +118,12 @@ void picosat_set_verbosity (PicoSAT *, int new_verbosity_level);
  */
 void picosat_set_plain (PicoSAT *, int new_plain_value);
 
+/* Set the number of conflicts the restart schedule is measured in.  The
+ * intervals between restarts follow the Luby sequence multiplied by this
+ * unit, which defaults to 100.  Smaller units restart more aggressively.
+ */
+void picosat_set_restart_unit (PicoSAT *, unsigned conflicts);
+
 /* Set default initial phase:
  *
  *   0 = false
@@ -221,6 +227,35 @@ void picosat_set_interrupt (PicoSAT *,
                             void * external_state,
                             int (*interrupted)(void * external_state));
 
+/* Clause sharing between PicoSAT instances solving the same formula, e.g.
+ * in a parallel SAT solver.  After setting an export call back, each
+ * learned clause with at most 'max_size' literals, or with a glue (the
+ * number of decision levels of its literals) of at most 'max_glue', is
+ * passed to 'export' as a zero terminated array of literals, which is
+ * only valid during the call.
+ *
+ * An import call back is called whenever the solver is on decision level
+ * zero, i.e. at the start of the search and after restarts.  It should
+ * return one zero terminated clause on each call, and 0 when there are
+ * no more clauses to import.  The returned clause only needs to be valid
+ * until the next call.  Imported clauses have to be implied by the
+ * original clauses, and should only contain variables known to this
+ * instance (other clauses are ignored).  Neither import nor export work
+ * together with contexts ('picosat_push'), trace generation or RUP files.
+ */
+void picosat_set_clause_export (PicoSAT *,
+                                void * external_state,
+                                void (*export)(void * external_state,
+                                               const int * lits,
+                                               int size,
+                                               unsigned glue),
+                                int max_size,
+                                unsigned max_glue);
+
+void picosat_set_clause_import (PicoSAT *,
+                                void * external_state,
+                                const int * (*import)(void * external_state));
+
 /*------------------------------------------------------------------------*/
 /* This function returns the next available unused variable index and
  * allocates a variable for it even though this variable does not occur as
@@ -321,6 +356,15 @@ int picosat_add_arg (PicoSAT *, ...);
  */
 int picosat_add_lits (PicoSAT *, int * lits);
 
+/* Add many clauses at once.  The 'n' literals in 'lits' form a flat list
+ * of clauses, each of which is terminated by a zero literal, so 'lits[n-1]'
+ * has to be zero.  The literals are checked in one pass, all internal
+ * tables are resized only once, and then the clauses are added without
+ * the per literal overhead of 'picosat_add'.  The return value is the
+ * original clause index of the first clause added.
+ */
+int picosat_add_clauses (PicoSAT *, const int * lits, size_t n);
+
 /* Print the CNF to the given file in DIMACS format.
  */
 void picosat_print (PicoSAT *, FILE *);
@@ -420,6 +464,32 @@ void picosat_assume (PicoSAT *, int lit);
  */
 void picosat_add_ado_lit (PicoSAT *, int);
 
+/*------------------------------------------------------------------------*/
+/* Add an xor constraint, which is satisfied if an odd number of its
+ * literals is true (negate one literal for an even number).  The literals
+ * are added one by one and terminated by zero, just like the literals of
+ * a clause.  Instead of the exponentially many clauses of its CNF
+ * encoding, the constraint is propagated natively.  Whenever new xor
+ * constraints were added, Gaussian elimination on the top level derives
+ * the units and equivalences implied by their sum.  Xor constraints can
+ * not be added in contexts, and not together with trace generation, RUP
+ * files or saved original clauses.
+ */
+void picosat_add_xor_lit (PicoSAT *, int);
+
+/*------------------------------------------------------------------------*/
+/* Add a cardinality constraint, which is satisfied if at most 'bound' of
+ * the 'n' literals are true (at least 'k' literals are true if at most
+ * 'n - k' of their negations are).  The constraint is propagated natively
+ * by counting its true literals, instead of the quadratic number of
+ * binary clauses of the pairwise encoding of an at most one constraint, or
+ * the auxiliary variables of other encodings.  Reasons are generated as
+ * clauses on demand.  Cardinality constraints can not be added in
+ * contexts, and not together with trace generation, RUP files or saved
+ * original clauses.
+ */
+void picosat_add_atmost (PicoSAT *, const int * lits, int n, int bound);
+
 /*------------------------------------------------------------------------*/
 /* Call the main SAT routine.  A negative decision limit sets no limit on
  * the number of decisions.  The return values are as above, e.g.
@@ -427,6 +497,22 @@ void picosat_add_ado_lit (PicoSAT *, int);
  */
 int picosat_sat (PicoSAT *, int decision_limit);
 
+/* After 'picosat_sat' or this function returned 'PICOSAT_SATISFIABLE',
+ * search for the next satisfying assignment.  The decisions on the first
+ * 'level' decision levels (all decisions if 'level' is negative, see
+ * 'picosat_decision_literals') are blocked by adding their negation as an
+ * original clause.  Instead of restarting the search from the top level,
+ * as 'picosat_sat' would, the solver only backtracks to the level before
+ * the last blocked decision, on which the new clause flips this decision,
+ * and continues from there.  Calling this function repeatedly enumerates
+ * all satisfying assignments (or their projections onto the variables
+ * decided on the first 'level' levels) like a backtracking search with
+ * conflict learning.  It can not be used together with assumptions,
+ * contexts, trace generation or RUP files.  The decision limit and return
+ * values are as for 'picosat_sat'.
+ */
+int picosat_next_model (PicoSAT *, int level, int decision_limit);
+
 /* As alternative to a decision limit you can use the number of propagations
  * as limit.  This is more linearly related to execution time. This has to
  * be called after 'picosat_init' and before 'picosat_sat'.
@@ -460,6 +546,23 @@ int picosat_deref_toplevel (PicoSAT *, int lit);
  */
 int picosat_deref_partial (PicoSAT *, int lit);
 
+/* After 'picosat_sat' was called and returned 'PICOSAT_SATISFIABLE', the
+ * decisions leading to the satisfying assignment are returned as a zero
+ * terminated array of literals, ordered by decision level, which includes
+ * the assumptions.  All other literals of the assignment are implied by
+ * these through unit propagation, so the negation of the decisions is a
+ * (usually much shorter) clause which blocks just this assignment.  The
+ * array is only valid until the next call of this function.
+ */
+const int * picosat_decision_literals (PicoSAT *);
+
+/* Returns the decision level on which the variable of the literal was
+ * assigned in the satisfying assignment, where '0' means that it is
+ * forced at the top level, or '-1' if it is unassigned.  The i-th
+ * decision literal (counting from one) was decided on level i.
+ */
+int picosat_deref_level (PicoSAT *, int lit);
+
 /* Returns non zero if the CNF is unsatisfiable because an empty clause was
  * added or derived.
  */
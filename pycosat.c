@@ -8,6 +8,7 @@
 #define PYCOSAT_VERSION  "0.6.6"
 
 #include <Python.h>
+#include <pythread.h>
 
 #ifdef _MSC_VER
 #define NGETRUSAGE
@@ -19,6 +20,24 @@
 #include "picosat.c"
 #endif
 
+#include <errno.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#ifndef O_BINARY
+#define O_BINARY  0
+#endif
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+
 /* When defined, picosat uses the Python memory manager
    We cannot do this while we:
    "release GIL during main picosat computation"
@@ -44,6 +63,41 @@
 #define PyUnicode_FromString  PyString_FromString
 #endif
 
+#if PY_VERSION_HEX < 0x03040000
+/* the raw memory interface (which does not need the GIL) is new in 3.4,
+   before that PyMem_Malloc() and friends are plain malloc() anyway */
+#define PyMem_RawMalloc  malloc
+#define PyMem_RawRealloc  realloc
+#define PyMem_RawFree  free
+#endif
+
+#ifndef IS_PY3K
+/* Python 2 has no PyUnicode_FSConverter(), but its file names are byte
+   strings already (or unicode strings, which are encoded) */
+static int fs_converter(PyObject *obj, void *result)
+{
+    PyObject *bytes;
+
+    if (PyUnicode_Check(obj))
+        bytes = PyUnicode_AsEncodedString(obj, Py_FileSystemDefaultEncoding,
+                                          NULL);
+    else if (PyString_Check(obj)) {
+        Py_INCREF(obj);
+        bytes = obj;
+    }
+    else {
+        PyErr_Format(PyExc_TypeError, "expected str, got %.200s",
+                     Py_TYPE(obj)->tp_name);
+        return 0;
+    }
+    if (bytes == NULL)
+        return 0;
+    *((PyObject **) result) = bytes;
+    return 1;
+}
+#define PyUnicode_FSConverter  fs_converter
+#endif
+
 #if defined(WITH_PYMEM)
 /* the following three adapter functions are used as arguments to
    picosat_minit, such that picosat used the Python memory manager */
@@ -63,7 +117,11 @@ inline static void py_free(void *mmgr, void *ptr, size_t bytes)
 }
 #endif
 
-/* Add the inverse of the (current) solution to the clauses.
+/* Add the inverse of the (current) solution to the clauses, where mem[i]
+   is the value (1 or -1) of variable i in the solution, for i = 1, ...,
+   picosat_variables(picosat).  Variables with mem[i] == 0 are not part of
+   the inverse, which is how solutions projected onto a subset of the
+   variables are blocked.
    This function is essentially the same as the function blocksol in app.c
    in the picosat source. */
 static int blocksol(PicoSAT *picosat, signed char *mem)
@@ -78,53 +136,380 @@ static int blocksol(PicoSAT *picosat, signed char *mem)
     max_idx = picosat_variables(picosat);
 
     for (i = 1; i <= max_idx; i++)
-        mem[i] = (picosat_deref(picosat, i) > 0) ? 1 : -1;
-
-    for (i = 1; i <= max_idx; i++)
-        picosat_add(picosat, (mem[i] < 0) ? i : -i);
+        if (mem[i])
+            picosat_add(picosat, (mem[i] < 0) ? i : -i);
 
     picosat_add(picosat, 0);
     return 0;
 }
 
-static int add_clause(PicoSAT *picosat, PyObject *clause)
+/* convert a Python integer into a (non-zero) picosat literal */
+static int get_lit(PyObject *obj, int *lit)
+{
+    long v;
+
+    if (!IS_INT(obj)) {
+        PyErr_SetString(PyExc_TypeError, "integer expected");
+        return -1;
+    }
+    v = PyLong_AsLong(obj);
+    if (v == -1 && PyErr_Occurred())
+        return -1;
+    if (v == 0) {
+        PyErr_SetString(PyExc_ValueError, "non-zero integer expected");
+        return -1;
+    }
+    if (v > INT_MAX || v < -INT_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "literal out of range");
+        return -1;
+    }
+    *lit = (int) v;
+    return 0;
+}
+
+/* The literals of a clause are collected before any of them is handed to
+   picosat, such that a bad literal does not leave an incomplete clause
+   behind (which matters for a Solver object which outlives the error). */
+#define CLAUSE_STACK_SIZE  64
+
+/* Collect the literals of an iterable into a zero terminated int array.
+   Short arrays are stored in stack (which has room for CLAUSE_STACK_SIZE
+   ints), longer ones are allocated, and have to be released using
+   free_lits().  Return the number of literals, or -1 on error. */
+static Py_ssize_t get_lits(PyObject *iterable, int *stack, int **plits)
 {
-    PyObject *iterator;         /* each clause is an iterable of literals */
+    PyObject *iterator;
     PyObject *lit;              /* the literals are integers */
+    int *lits = stack, *tmp;
+    Py_ssize_t n = 0, size = CLAUSE_STACK_SIZE;
     int v;
 
-    iterator = PyObject_GetIter(clause);
+    iterator = PyObject_GetIter(iterable);
     if (iterator == NULL)
         return -1;
 
     while ((lit = PyIter_Next(iterator)) != NULL) {
-        if (!IS_INT(lit))  {
+        if (get_lit(lit, &v) < 0) {
             Py_DECREF(lit);
-            Py_DECREF(iterator);
-            PyErr_SetString(PyExc_TypeError, "integer expected");
-            return -1;
+            goto error;
         }
-        v = PyLong_AsLong(lit);
         Py_DECREF(lit);
-        if (v == 0) {
-            Py_DECREF(iterator);
-            PyErr_SetString(PyExc_ValueError, "non-zero integer expected");
-            return -1;
+        if (n + 1 == size) {    /* keep room for the terminating zero */
+            tmp = PyMem_Malloc(2 * size * sizeof(int));
+            if (tmp == NULL) {
+                PyErr_NoMemory();
+                goto error;
+            }
+            memcpy(tmp, lits, n * sizeof(int));
+            if (lits != stack)
+                PyMem_Free(lits);
+            lits = tmp;
+            size *= 2;
         }
-        picosat_add(picosat, v);
+        lits[n++] = v;
     }
-    Py_DECREF(iterator);
     if (PyErr_Occurred())
+        goto error;
+    Py_DECREF(iterator);
+
+    lits[n] = 0;
+    *plits = lits;
+    return n;
+
+error:
+    Py_DECREF(iterator);
+    if (lits != stack)
+        PyMem_Free(lits);
+    return -1;
+}
+
+static void free_lits(int *lits, int *stack)
+{
+    if (lits != stack)
+        PyMem_Free(lits);
+}
+
+static int add_clause(PicoSAT *picosat, PyObject *clause)
+{
+    int stack[CLAUSE_STACK_SIZE], *lits;
+    Py_ssize_t n;
+
+    /* each clause is an iterable of literals */
+    if ((n = get_lits(clause, stack, &lits)) < 0)
         return -1;
-    picosat_add(picosat, 0);
+    picosat_add_clauses(picosat, lits, (size_t) n + 1);
+    free_lits(lits, stack);
+    return 0;
+}
+
+/* Add the constraint that the xor of the n literals is rhs, which
+   picosat propagates natively.  Its xor constraints are true when an odd
+   number of literals is true, so one literal is negated when rhs is 0. */
+static void add_xor_constraint(PicoSAT *picosat, const int *lits,
+                               Py_ssize_t n, int rhs)
+{
+    Py_ssize_t i;
+
+    if (n || rhs) {
+        for (i = 0; i < n; i++)
+            picosat_add_xor_lit(picosat, (i == 0 && !rhs) ? -lits[i]
+                                                          : lits[i]);
+        picosat_add_xor_lit(picosat, 0);
+    }
+}
+
+/* Return the number of bytes of a signed integer buffer format, as given
+   by the buffer protocol, or 0 if the format is not a signed integer type
+   (of more than one byte) in native byte order.  No format at all (see
+   get_int_buffer) means raw native ints, which is reported as
+   sizeof(int). */
+static int buffer_int_size(const char *format)
+{
+    const int one = 1;
+    int little = *((const char *) &one);
+
+    if (format == NULL)
+        return (int) sizeof(int);
+
+    switch (*format) {
+    case '@': case '=':
+        format++;
+        break;
+    case '<':
+        if (!little)
+            return 0;
+        format++;
+        break;
+    case '>': case '!':
+        if (little)
+            return 0;
+        format++;
+        break;
+    }
+    if (format[0] == '\0' || format[1] != '\0')
+        return 0;
+
+    switch (*format) {
+    case 'h':
+        return (int) sizeof(short);
+    case 'i':
+        return (int) sizeof(int);
+    case 'l':
+        return (int) sizeof(long);
+    case 'q':
+        return (int) sizeof(long long);
+    case 'n':
+        return (int) sizeof(Py_ssize_t);
+    }
     return 0;
 }
 
+enum {                              /* errors in literal streams */
+    STREAM_OK = 0,
+    STREAM_RANGE,                   /* literal out of range */
+    STREAM_UNTERMINATED,            /* last clause without trailing zero */
+};
+
+/* Convert the n integers (of the given size) at buf into ints at out,
+   which may be buf itself when the integers are native ints, and check
+   that the result is a zero terminated stream of valid literals.  Return
+   one of the STREAM_ codes above.  This does not need the GIL. */
+static int convert_stream(const void *buf, int size, Py_ssize_t n, int *out)
+{
+    Py_ssize_t i;
+    long long v;
+
+    if (size == (int) sizeof(int)) {
+        if (out != buf)
+            memcpy(out, buf, n * sizeof(int));
+        for (i = 0; i < n; i++)
+            if (out[i] == INT_MIN)
+                return STREAM_RANGE;
+    }
+    else {
+        for (i = 0; i < n; i++) {
+            switch (size) {
+            case sizeof(short):
+                v = ((const short *) buf)[i];
+                break;
+            case sizeof(long long):
+                v = ((const long long *) buf)[i];
+                break;
+            default:
+                v = ((const long *) buf)[i];
+            }
+            if (v > INT_MAX || v < -INT_MAX)
+                return STREAM_RANGE;
+            out[i] = (int) v;
+        }
+    }
+    if (n > 0 && out[n - 1] != 0)
+        return STREAM_UNTERMINATED;
+    return STREAM_OK;
+}
+
+/* set the exception for an error returned by convert_stream() */
+static int stream_error(int err)
+{
+    if (err == STREAM_RANGE)
+        PyErr_SetString(PyExc_OverflowError, "literal out of range");
+    else
+        PyErr_SetString(PyExc_ValueError,
+                        "zero terminated literal stream expected");
+    return -1;
+}
+
+/* Get the buffer of obj, and return the size of its integers, or -1 (with
+   the buffer released) if it is not a buffer of signed integers.  Only
+   bytes and bytearray objects, which have no format of their own, are
+   taken to hold raw native ints, whereas typed buffers of single bytes
+   (e.g. array('b') or NumPy int8 arrays) are rejected. */
+static int get_int_buffer(PyObject *obj, Py_buffer *view)
+{
+    int size, raw = PyBytes_Check(obj) || PyByteArray_Check(obj);
+
+    if (PyObject_GetBuffer(obj, view, raw ? PyBUF_C_CONTIGUOUS :
+                           PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+        return -1;
+
+    size = buffer_int_size(raw ? NULL : view->format);
+    if (size == 0 || (view->itemsize != 1 && view->itemsize != size) ||
+            view->len % size) {
+        PyErr_Format(PyExc_TypeError, "buffer of signed integers "
+                     "expected, got format '%s'",
+                     view->format ? view->format : "B");
+        PyBuffer_Release(view);
+        return -1;
+    }
+    return size;
+}
+
+/* Add clauses from an object which supports the buffer protocol, e.g.
+   array('i'), a NumPy integer array, a memoryview or bytes.  The buffer
+   holds a flat stream of literals, in which each clause is terminated by
+   a zero.  Streams of native ints are read in place, other integer sizes
+   are converted into a temporary int array first.  The whole stream is
+   validated before it is handed to picosat_add_clauses(), and the GIL
+   is released while the literals are read. */
+static int add_clauses_buffer(PicoSAT *picosat, PyObject *obj)
+{
+    Py_buffer view;
+    int *lits;                  /* the literal stream as ints */
+    int *tmp = NULL;            /* converted stream, unless read in place */
+    Py_ssize_t n;
+    int size, err;
+
+    if ((size = get_int_buffer(obj, &view)) < 0)
+        return -1;
+    n = view.len / size;
+
+    if (size == (int) sizeof(int)) {
+        lits = (int *) view.buf;
+    }
+    else {
+        tmp = PyMem_RawMalloc(n * sizeof(int) + 1);
+        if (tmp == NULL) {
+            PyBuffer_Release(&view);
+            PyErr_NoMemory();
+            return -1;
+        }
+        lits = tmp;
+    }
+
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    err = convert_stream(view.buf, size, n, lits);
+    if (err == STREAM_OK)
+        picosat_add_clauses(picosat, lits, (size_t) n);
+    Py_END_ALLOW_THREADS
+
+    if (tmp)
+        PyMem_RawFree(tmp);
+    PyBuffer_Release(&view);
+
+    return err == STREAM_OK ? 0 : stream_error(err);
+}
+
+/* Return a new zero terminated literal stream (allocated using
+   PyMem_RawMalloc), holding the clauses (or other lists of literals) of
+   obj, which is either an iterable of iterables of integers, or a buffer
+   as described above.  The number of ints is stored in *pn. */
+static int* get_stream(PyObject *obj, Py_ssize_t *pn)
+{
+    Py_buffer view;
+    PyObject *iterator, *item;
+    int stack[CLAUSE_STACK_SIZE], *lits, *stream = NULL, *tmp;
+    Py_ssize_t n = 0, size = 0, k;
+    int isize, err;
+
+    if (PyObject_CheckBuffer(obj)) {
+        if ((isize = get_int_buffer(obj, &view)) < 0)
+            return NULL;
+        n = view.len / isize;
+        stream = PyMem_RawMalloc(n * sizeof(int) + 1);
+        if (stream == NULL) {
+            PyBuffer_Release(&view);
+            PyErr_NoMemory();
+            return NULL;
+        }
+        err = convert_stream(view.buf, isize, n, stream);
+        PyBuffer_Release(&view);
+        if (err != STREAM_OK) {
+            PyMem_RawFree(stream);
+            stream_error(err);
+            return NULL;
+        }
+        *pn = n;
+        return stream;
+    }
+
+    iterator = PyObject_GetIter(obj);
+    if (iterator == NULL)
+        return NULL;
+
+    while ((item = PyIter_Next(iterator)) != NULL) {
+        k = get_lits(item, stack, &lits);
+        Py_DECREF(item);
+        if (k < 0)
+            goto error;
+        if (n + k + 1 > size) {
+            size = 2 * (n + k + 1) + 1024;
+            tmp = PyMem_RawRealloc(stream, size * sizeof(int));
+            if (tmp == NULL) {
+                free_lits(lits, stack);
+                PyErr_NoMemory();
+                goto error;
+            }
+            stream = tmp;
+        }
+        memcpy(stream + n, lits, (k + 1) * sizeof(int));
+        n += k + 1;
+        free_lits(lits, stack);
+    }
+    if (PyErr_Occurred())
+        goto error;
+    Py_DECREF(iterator);
+
+    if (stream == NULL && (stream = PyMem_RawMalloc(sizeof(int))) == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    *pn = n;
+    return stream;
+
+error:
+    Py_DECREF(iterator);
+    PyMem_RawFree(stream);
+    return NULL;
+}
+
 static int add_clauses(PicoSAT *picosat, PyObject *clauses)
 {
     PyObject *iterator;       /* clauses can be any iterable */
     PyObject *item;           /* each clause is an iterable of integers */
 
+    if (PyObject_CheckBuffer(clauses))
+        return add_clauses_buffer(picosat, clauses);
+
     iterator = PyObject_GetIter(clauses);
     if (iterator == NULL)
         return -1;
@@ -143,211 +528,5148 @@ static int add_clauses(PicoSAT *picosat, PyObject *clauses)
     return 0;
 }
 
-static PicoSAT* setup_picosat(PyObject *args, PyObject *kwds)
-{
-    PicoSAT *picosat;
-    PyObject *clauses;          /* iterable of clauses */
-    int vars = -1, verbose = 0;
-    unsigned long long prop_limit = 0;
-    static char* kwlist[] = {"clauses",
-                             "vars", "verbose", "prop_limit", NULL};
+/*************************** DIMACS reader *************************/
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iiK:(iter)solve", kwlist,
-                                     &clauses,
-                                     &vars, &verbose, &prop_limit))
-        return NULL;
+/* A DIMACS CNF file is parsed by a small state machine, which is fed the
+   file contents in chunks: all of it at once when the file can be mapped
+   into memory, or a buffer at a time when it is read from a stream (for
+   gzip compressed files).  The literals are collected into an int stack,
+   and whenever the stack is full, the complete clauses on it are handed
+   to picosat_add_clauses().  No Python objects are involved, such that
+   the whole file is read with the GIL released. */
 
-#if defined(WITH_PYMEM)
-    picosat = picosat_minit(NULL, py_malloc, py_realloc, py_free);
-#else
-    picosat = picosat_init();
-#endif
-    picosat_set_verbosity(picosat, verbose);
-    if (vars != -1)
-        picosat_adjust(picosat, vars);
+#define DIMACS_CHUNK  (1 << 20)     /* bytes read at once from a stream */
+#define DIMACS_FLUSH  (1 << 20)     /* literals stacked before adding */
+#define DEFLATE_RATIO 1032          /* largest expansion of deflate */
 
-    if (prop_limit)
-        picosat_set_propagation_limit(picosat, prop_limit);
+enum {                              /* parser errors */
+    DIMACS_OK = 0,
+    DIMACS_IO,                      /* reading the file failed (errno) */
+    DIMACS_NOMEM,
+    DIMACS_SYNTAX,                  /* unexpected character */
+    DIMACS_HEADER,                  /* invalid 'p cnf' line */
+    DIMACS_RANGE,                   /* literal out of range */
+    DIMACS_UNTERMINATED,            /* last clause without trailing zero */
+    DIMACS_NOZLIB,                  /* gzip file, but built without zlib */
+};
 
-    if (add_clauses(picosat, clauses) < 0) {
-        picosat_reset(picosat);
-        return NULL;
-    }
+enum {                              /* parser states */
+    S_SPACE,                        /* between tokens */
+    S_SIGN,                         /* after '-' */
+    S_NUMBER,                       /* inside a number */
+    S_COMMENT,                      /* inside a 'c' line */
+    S_HEADER,                       /* inside the 'p' line */
+    S_END,                          /* after '%', ignore the rest */
+};
 
-    if (verbose >= 2)
-        picosat_print(picosat, stdout);
+typedef struct {
+    PicoSAT *picosat;
+    int *lits;                      /* literals not yet added */
+    size_t n, size;                 /* number of, and room for literals */
+    size_t complete;                /* literals of complete clauses */
+    int state;
+    int neg;                        /* sign of the current number */
+    unsigned long long num;         /* value of the current number */
+    char header[64];                /* the 'p' line */
+    size_t hlen;
+    size_t line;                    /* current line, for error messages */
+    int max_vars;                   /* most variables the file can have */
+    int error;                      /* one of DIMACS_ above */
+    int sys_errno;                  /* errno for DIMACS_IO */
+} dimacs_t;
 
-    return picosat;
+static void dimacs_flush(dimacs_t *d)
+{
+    if (d->complete == 0)
+        return;
+    picosat_add_clauses(d->picosat, d->lits, d->complete);
+    d->n -= d->complete;
+    memmove(d->lits, d->lits + d->complete, d->n * sizeof(int));
+    d->complete = 0;
 }
 
-/* read the solution from the picosat object and return a Python list */
-static PyObject* get_solution(PicoSAT *picosat)
+static void dimacs_push(dimacs_t *d, int lit)
 {
-    PyObject *list;
-    int max_idx, i, v;
+    int *tmp;
+    size_t size;
 
-    max_idx = picosat_variables(picosat);
-    list = PyList_New((Py_ssize_t) max_idx);
-    if (list == NULL) {
-        picosat_reset(picosat);
-        return NULL;
-    }
-    for (i = 1; i <= max_idx; i++) {
-        v = picosat_deref(picosat, i);
-        assert(v == -1 || v == 1);
-        if (PyList_SetItem(list, (Py_ssize_t) (i - 1),
-                           PyInt_FromLong((long) (v * i))) < 0) {
-            Py_DECREF(list);
-            picosat_reset(picosat);
-            return NULL;
+    if (d->n == d->size) {
+        if (d->complete && d->size >= DIMACS_FLUSH) {
+            dimacs_flush(d);
+        }
+        else {
+            size = d->size ? 2 * d->size : 1024;
+            tmp = PyMem_RawRealloc(d->lits, size * sizeof(int));
+            if (tmp == NULL) {
+                d->error = DIMACS_NOMEM;
+                return;
+            }
+            d->lits = tmp;
+            d->size = size;
         }
     }
-    return list;
+    d->lits[d->n++] = lit;
+    if (lit == 0)
+        d->complete = d->n;
 }
 
-static PyObject* solve(PyObject *self, PyObject *args, PyObject *kwds)
+static void dimacs_header(dimacs_t *d)
 {
-    PicoSAT *picosat;
-    PyObject *result = NULL;    /* return value */
-    int res;
+    int vars, clauses;
+    char dummy;
 
-    picosat = setup_picosat(args, kwds);
-    if (picosat == NULL)
-        return NULL;
+    d->header[d->hlen] = '\0';
+    if (sscanf(d->header, "p cnf %d %d %c", &vars, &clauses, &dummy) != 2 ||
+            vars < 0 || clauses < 0) {
+        d->error = DIMACS_HEADER;
+        return;
+    }
+    /* The header is only a hint to size picosat in advance, which must
+       not be trusted beyond what the file can hold.  The literals of the
+       clauses grow picosat as needed anyway. */
+    picosat_adjust(d->picosat, vars < d->max_vars ? vars : d->max_vars);
+}
 
-    Py_BEGIN_ALLOW_THREADS      /* release GIL */
-    res = picosat_sat(picosat, -1);
-    Py_END_ALLOW_THREADS
+#define IS_SPACE(c)  ((c) == ' ' || (c) == '\n' || (c) == '\t' || \
+                      (c) == '\r' || (c) == '\v' || (c) == '\f')
 
-    switch (res) {
-    case PICOSAT_SATISFIABLE:
-        result = get_solution(picosat);
-        break;
+static void dimacs_parse(dimacs_t *d, const char *p, const char *end)
+{
+    unsigned char ch;
 
-    case PICOSAT_UNSATISFIABLE:
-        result = PyUnicode_FromString("UNSAT");
-        break;
+    for (; p < end && d->error == DIMACS_OK; p++) {
+        ch = (unsigned char) *p;
+        switch (d->state) {
+        case S_SPACE:
+            if (IS_SPACE(ch))
+                break;
+            if ('0' <= ch && ch <= '9') {
+                d->neg = 0;
+                d->num = ch - '0';
+                d->state = S_NUMBER;
+            }
+            else if (ch == '-') {
+                d->neg = 1;
+                d->num = 0;
+                d->state = S_SIGN;
+            }
+            else if (ch == 'c') {
+                d->state = S_COMMENT;
+            }
+            else if (ch == 'p') {
+                d->header[0] = 'p';
+                d->hlen = 1;
+                d->state = S_HEADER;
+            }
+            else if (ch == '%') {
+                d->state = S_END;
+            }
+            else {
+                d->error = DIMACS_SYNTAX;
+            }
+            break;
 
-    case PICOSAT_UNKNOWN:
-        result = PyUnicode_FromString("UNKNOWN");
-        break;
+        case S_SIGN:
+        case S_NUMBER:
+            if ('0' <= ch && ch <= '9') {
+                d->num = 10 * d->num + (ch - '0');
+                if (d->num > INT_MAX)
+                    d->error = DIMACS_RANGE;
+                d->state = S_NUMBER;
+            }
+            else if (d->state == S_NUMBER && IS_SPACE(ch)) {
+                dimacs_push(d, d->neg ? -(int) d->num : (int) d->num);
+                d->state = S_SPACE;
+            }
+            else {
+                d->error = DIMACS_SYNTAX;
+            }
+            break;
 
-    default:
-        PyErr_Format(PyExc_SystemError, "picosat return value: %d", res);
+        case S_COMMENT:
+            if (ch == '\n')
+                d->state = S_SPACE;
+            break;
+
+        case S_HEADER:
+            if (ch == '\n') {
+                dimacs_header(d);
+                d->state = S_SPACE;
+            }
+            else if (d->hlen + 1 < sizeof(d->header)) {
+                d->header[d->hlen++] = (char) ch;
+            }
+            else {
+                d->error = DIMACS_HEADER;
+            }
+            break;
+
+        case S_END:
+            return;
+        }
+        if (ch == '\n' && d->error == DIMACS_OK)
+            d->line++;
     }
+}
 
-    picosat_reset(picosat);
-    return result;
+/* called at the end of the file, or after an error */
+static void dimacs_finish(dimacs_t *d)
+{
+    if (d->error == DIMACS_OK) {
+        switch (d->state) {
+        case S_NUMBER:
+            dimacs_push(d, d->neg ? -(int) d->num : (int) d->num);
+            break;
+        case S_SIGN:
+            d->error = DIMACS_SYNTAX;
+            break;
+        case S_HEADER:
+            dimacs_header(d);
+            break;
+        }
+    }
+    if (d->error == DIMACS_OK && d->n > d->complete)
+        d->error = DIMACS_UNTERMINATED;
+    /* add the complete clauses, even when an error occurred later */
+    dimacs_flush(d);
 }
 
-PyDoc_STRVAR(solve_doc,
-"solve(clauses [, kwargs]) -> list\n\
-\n\
-Solve the SAT problem for the clauses, and return a solution as a\n\
-list of integers, or one of the strings \"UNSAT\", \"UNKNOWN\".\n\
-Please see " PYCOSAT_URL " for more details.");
+/* feed the parser from a stream, which is either a gzFile or a FILE */
+static void dimacs_stream(dimacs_t *d, void *stream, int gz)
+{
+    char *buf;
+    long n;
 
-/*********************** Solution Iterator *********************/
+    buf = PyMem_RawMalloc(DIMACS_CHUNK);
+    if (buf == NULL) {
+        d->error = DIMACS_NOMEM;
+        return;
+    }
+    while (d->error == DIMACS_OK && d->state != S_END) {
+#ifdef WITH_ZLIB
+        if (gz)
+            n = gzread((gzFile) stream, buf, DIMACS_CHUNK);
+        else
+#endif
+        {
+            n = (long) fread(buf, 1, DIMACS_CHUNK, (FILE *) stream);
+            if (n == 0 && ferror((FILE *) stream))
+                n = -1;
+        }
+        if (n < 0) {
+            d->error = DIMACS_IO;
+            d->sys_errno = errno ? errno : EIO;
+        }
+        if (n <= 0)
+            break;
+        dimacs_parse(d, buf, buf + n);
+    }
+    PyMem_RawFree(buf);
+}
 
-typedef struct {
-    PyObject_HEAD
-    PicoSAT *picosat;
-    signed char *mem;           /* temporary storage */
-} soliterobject;
+/* Return the size of the regular file, or 0 when it is unknown. */
+static long long file_size(FILE *file)
+{
+#ifdef _WIN32
+    long long size = _filelengthi64(_fileno(file));
 
-static PyTypeObject SolIter_Type;
+    return size > 0 ? size : 0;
+#else
+    struct stat st;
 
-#define SolIter_Check(op)  PyObject_TypeCheck(op, &SolIter_Type)
+    if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode))
+        return (long long) st.st_size;
+    return 0;
+#endif
+}
 
-static PyObject* itersolve(PyObject *self, PyObject *args, PyObject *kwds)
+static void dimacs_read(dimacs_t *d, const char *path)
 {
-    soliterobject *it;          /* iterator to be returned */
+    FILE *file;
+    unsigned char magic[2];
+    long long size;
+    int gz;
 
-    it = PyObject_GC_New(soliterobject, &SolIter_Type);
-    if (it == NULL)
-        return NULL;
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        d->error = DIMACS_IO;
+        d->sys_errno = errno;
+        return;
+    }
+    gz = (fread(magic, 1, 2, file) == 2 &&
+          magic[0] == 0x1f && magic[1] == 0x8b);
 
-    it->picosat = setup_picosat(args, kwds);
-    if (it->picosat == NULL)
-        return NULL;
+    /* each variable takes at least two bytes, as in "1 " */
+    size = file_size(file);
+    if (gz)
+        size = size < INT_MAX / DEFLATE_RATIO ? size * DEFLATE_RATIO :
+                                                INT_MAX;
+    d->max_vars = (int) (size / 2 < INT_MAX ? size / 2 : INT_MAX);
 
-    it->mem = PyMem_Calloc(picosat_variables(it->picosat) + 1, 1);
-    if (it->mem == NULL) {
-        PyErr_NoMemory();
-        return NULL;
+    if (gz) {
+#ifdef WITH_ZLIB
+        gzFile gzfile;
+
+        fclose(file);
+        gzfile = gzopen(path, "rb");
+        if (gzfile == NULL) {
+            d->error = DIMACS_IO;
+            d->sys_errno = errno ? errno : ENOMEM;
+            return;
+        }
+        gzbuffer(gzfile, DIMACS_CHUNK);
+        dimacs_stream(d, gzfile, 1);
+        gzclose(gzfile);
+#else
+        fclose(file);
+        d->error = DIMACS_NOZLIB;
+#endif
+        return;
     }
 
-    PyObject_GC_Track(it);
-    return (PyObject *) it;
-}
+#ifndef _WIN32
+    {
+        struct stat st;
+        void *data;
 
-PyDoc_STRVAR(itersolve_doc,
-"itersolve(clauses [, kwargs]) -> iterator\n\
-\n\
-Solve the SAT problem for the clauses, and return an iterator over\n\
-the solutions (which are lists of integers).\n\
-Please see " PYCOSAT_URL " for more details.");
+        /* map regular files into memory, and parse them in one go */
+        if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) &&
+                st.st_size > 0) {
+            data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE,
+                        fileno(file), 0);
+            if (data != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+                madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+#endif
+                dimacs_parse(d, (const char *) data,
+                             (const char *) data + st.st_size);
+                munmap(data, (size_t) st.st_size);
+                fclose(file);
+                return;
+            }
+        }
+    }
+#endif
+    rewind(file);
+    dimacs_stream(d, file, 0);
+    fclose(file);
+}
 
-static PyObject* soliter_next(soliterobject *it)
+/* Read the DIMACS CNF file at path (a str, bytes or os.PathLike object)
+   into picosat.  When an error is raised, the clauses read before the
+   error have been added already, but never an incomplete clause. */
+static int load_dimacs(PicoSAT *picosat, PyObject *path)
 {
-    PyObject *result = NULL;    /* return value */
-    int res;
+    PyObject *bytes;
+    const char *name;
+    dimacs_t d;
 
-    assert(SolIter_Check(it));
+    if (!PyUnicode_FSConverter(path, &bytes))
+        return -1;
+    name = PyBytes_AS_STRING(bytes);
 
+    memset(&d, 0, sizeof(d));
+    d.picosat = picosat;
+    d.line = 1;
+
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    dimacs_read(&d, name);
+    dimacs_finish(&d);
+    Py_END_ALLOW_THREADS
+
+    PyMem_RawFree(d.lits);
+
+    switch (d.error) {
+    case DIMACS_OK:
+        break;
+    case DIMACS_IO:
+        errno = d.sys_errno;
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, name);
+        break;
+    case DIMACS_NOMEM:
+        PyErr_NoMemory();
+        break;
+    case DIMACS_NOZLIB:
+        PyErr_Format(PyExc_ValueError, "%s: gzip compressed file, but "
+                     "pycosat was built without zlib", name);
+        break;
+    default:
+        PyErr_Format(PyExc_ValueError, "%s:%zu: %s", name, d.line,
+                     d.error == DIMACS_SYNTAX ? "unexpected character" :
+                     d.error == DIMACS_HEADER ? "invalid 'p cnf' header" :
+                     d.error == DIMACS_RANGE ? "literal out of range" :
+                     "clause not terminated by 0");
+    }
+    Py_DECREF(bytes);
+    return d.error == DIMACS_OK ? 0 : -1;
+}
+
+/* return a new (empty) picosat object */
+static PicoSAT* new_picosat(int vars, int verbose,
+                            unsigned long long prop_limit)
+{
+    PicoSAT *picosat;
+
+#if defined(WITH_PYMEM)
+    picosat = picosat_minit(NULL, py_malloc, py_realloc, py_free);
+#else
+    picosat = picosat_init();
+#endif
+    picosat_set_verbosity(picosat, verbose);
+    if (vars != -1)
+        picosat_adjust(picosat, vars);
+
+    if (prop_limit)
+        picosat_set_propagation_limit(picosat, prop_limit);
+
+    return picosat;
+}
+
+/* Load the clauses into picosat by load(picosat, obj), which is
+   add_clauses() or load_dimacs(), and return picosat.  On failure,
+   picosat is reset and NULL returned. */
+static PicoSAT* load_picosat(PicoSAT *picosat,
+                             int (*load)(PicoSAT *, PyObject *),
+                             PyObject *obj, int verbose)
+{
+    if (load(picosat, obj) < 0) {
+        picosat_reset(picosat);
+        return NULL;
+    }
+
+    if (verbose >= 2)
+        picosat_print(picosat, stdout);
+
+    return picosat;
+}
+
+/* Return a new picosat object, into which the clauses are loaded by
+   load(picosat, obj), see load_picosat(). */
+static PicoSAT* setup_picosat(int (*load)(PicoSAT *, PyObject *),
+                              PyObject *obj, int vars, int verbose,
+                              unsigned long long prop_limit)
+{
+    return load_picosat(new_picosat(vars, verbose, prop_limit),
+                        load, obj, verbose);
+}
+
+/* The output formats of a solution */
+enum {
+    OUTPUT_LIST = 0,            /* list of literals (default) */
+    OUTPUT_ARRAY,               /* array('i') of literals */
+    OUTPUT_BITSET,              /* bytes, bit i-1 set iff variable i true */
+    OUTPUT_POSITIVE,            /* list of the true (positive) literals */
+};
+
+static const char *output_names[] = {
+    "list", "array", "bitset", "positive", NULL
+};
+
+/* translate the name of an output format (or NULL for the default) into
+   one of the OUTPUT_ constants above, or return -1 with ValueError set */
+static int get_output(const char *name)
+{
+    int i;
+
+    if (name == NULL)
+        return OUTPUT_LIST;
+
+    for (i = 0; output_names[i]; i++)
+        if (strcmp(name, output_names[i]) == 0)
+            return i;
+
+    PyErr_Format(PyExc_ValueError, "output must be 'list', 'array', "
+                 "'bitset' or 'positive', got '%s'", name);
+    return -1;
+}
+
+static PyObject *array_type = NULL;    /* array.array, imported lazily */
+
+/* return a new array of the given typecode, holding the (native) items
+   in the size bytes at buf */
+static PyObject* new_array(const char *typecode, const void *buf,
+                           Py_ssize_t size)
+{
+    PyObject *bytes, *res;
+
+    if (array_type == NULL) {
+        PyObject *module = PyImport_ImportModule("array");
+        if (module == NULL)
+            return NULL;
+        array_type = PyObject_GetAttrString(module, "array");
+        Py_DECREF(module);
+        if (array_type == NULL)
+            return NULL;
+    }
+    bytes = PyBytes_FromStringAndSize((const char *) buf, size);
+    if (bytes == NULL)
+        return NULL;
+    res = PyObject_CallFunction(array_type, "sO", typecode, bytes);
+    Py_DECREF(bytes);
+    return res;
+}
+
+/* return a new array('i') holding the n ints from buf */
+static PyObject* new_int_array(const int *buf, Py_ssize_t n)
+{
+    return new_array("i", buf, n * (Py_ssize_t) sizeof(int));
+}
+
+/* return the solution given by the values vals[1], ..., vals[max_idx]
+   (each of which is 1 or -1) in the given output format, variables with
+   value 0 are left out (or unset in a bitset) */
+static PyObject* new_solution(const signed char *vals, int max_idx,
+                              int output)
+{
+    PyObject *res, *item;
+    int i, n, *lits;
+    unsigned char *bits;
+
+    switch (output) {
+    case OUTPUT_ARRAY:
+        lits = PyMem_Malloc((max_idx + 1) * sizeof(int));
+        if (lits == NULL)
+            return PyErr_NoMemory();
+        for (n = 0, i = 1; i <= max_idx; i++)
+            if (vals[i])
+                lits[n++] = vals[i] * i;
+        res = new_int_array(lits, n);
+        PyMem_Free(lits);
+        return res;
+
+    case OUTPUT_BITSET:
+        res = PyBytes_FromStringAndSize(NULL, (max_idx + 7) / 8);
+        if (res == NULL)
+            return NULL;
+        bits = (unsigned char *) PyBytes_AS_STRING(res);
+        memset(bits, 0, (max_idx + 7) / 8);
+        for (i = 1; i <= max_idx; i++)
+            if (vals[i] > 0)
+                bits[(i - 1) >> 3] |= 1 << ((i - 1) & 7);
+        return res;
+
+    case OUTPUT_POSITIVE:
+        res = PyList_New(0);
+        if (res == NULL)
+            return NULL;
+        for (i = 1; i <= max_idx; i++) {
+            if (vals[i] <= 0)
+                continue;
+            item = PyInt_FromLong((long) i);
+            if (item == NULL || PyList_Append(res, item) < 0) {
+                Py_XDECREF(item);
+                Py_DECREF(res);
+                return NULL;
+            }
+            Py_DECREF(item);
+        }
+        return res;
+    }
+
+    for (n = 0, i = 1; i <= max_idx; i++)
+        n += vals[i] != 0;
+
+    res = PyList_New((Py_ssize_t) n);
+    if (res == NULL)
+        return NULL;
+
+    for (n = 0, i = 1; i <= max_idx; i++) {
+        assert(-1 <= vals[i] && vals[i] <= 1);
+        if (vals[i] == 0)
+            continue;
+        if (PyList_SetItem(res, (Py_ssize_t) n++,
+                           PyInt_FromLong((long) (vals[i] * i))) < 0) {
+            Py_DECREF(res);
+            return NULL;
+        }
+    }
+    return res;
+}
+
+/* store the values of variables 1, ..., max_idx of the solution found by
+   picosat in vals[1], ..., vals[max_idx] */
+static void get_values(PicoSAT *picosat, signed char *vals, int max_idx)
+{
+    int i;
+
+    for (i = 1; i <= max_idx; i++)
+        vals[i] = (signed char) picosat_deref(picosat, i);
+}
+
+/* read the solution from the picosat object and return it in the given
+   output format, the picosat object itself is left untouched (also on
+   failure) */
+static PyObject* get_solution(PicoSAT *picosat, int output)
+{
+    PyObject *res;
+    signed char *vals;
+    int max_idx;
+
+    max_idx = picosat_variables(picosat);
+    vals = PyMem_Malloc(max_idx + 1);
+    if (vals == NULL)
+        return PyErr_NoMemory();
+    get_values(picosat, vals, max_idx);
+    res = new_solution(vals, max_idx, output);
+    PyMem_Free(vals);
+    return res;
+}
+
+/* translate the return value of picosat_sat() into the Python object
+   returned by solve(): a solution, "UNSAT" or "UNKNOWN" */
+static PyObject* get_result(PicoSAT *picosat, int res, int output)
+{
+    switch (res) {
+    case PICOSAT_SATISFIABLE:
+        return get_solution(picosat, output);
+
+    case PICOSAT_UNSATISFIABLE:
+        return PyUnicode_FromString("UNSAT");
+
+    case PICOSAT_UNKNOWN:
+        return PyUnicode_FromString("UNKNOWN");
+
+    default:
+        PyErr_Format(PyExc_SystemError, "picosat return value: %d", res);
+        return NULL;
+    }
+}
+
+/*************************** Time limits ****************************/
+
+/* Time limits are implemented by picosat's interrupt hook, which picosat
+   calls every INTERRUPTLIM decisions.  The hook compares our own
+   monotonic clock against a deadline, which is computed from the timeout
+   and deadline arguments (seconds, the latter in time.monotonic() time)
+   while the GIL is held.  Reading the clock is cheap (no system call on
+   most platforms), so time limits may be used all the time. */
+
+/* return the time of a monotonic clock in seconds */
+static double clock_monotonic(void)
+{
+#ifdef _WIN32
+    return (double) GetTickCount64() / 1e3;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+#endif
+}
+
+static PyObject *monotonic_func = NULL;  /* time.monotonic, lazily */
+
+/* Translate the timeout and deadline arguments (each either NULL, None or
+   a number) into a deadline on clock_monotonic(), which is stored in
+   *result, and 0 means no deadline.  When both are given, the earlier
+   one counts.  A timeout must not be negative, and neither may be NaN. */
+static int get_deadline(PyObject *timeout, PyObject *deadline,
+                        double *result)
+{
+    PyObject *now;
+    double remaining = 0.0, t;
+    int limited = 0;
+
+    if (timeout != NULL && timeout != Py_None) {
+        remaining = PyFloat_AsDouble(timeout);
+        if (remaining == -1.0 && PyErr_Occurred())
+            return -1;
+        if (Py_IS_NAN(remaining) || remaining < 0.0) {
+            PyErr_SetString(PyExc_ValueError,
+                            "timeout must be a non-negative number");
+            return -1;
+        }
+        limited = 1;
+    }
+    if (deadline != NULL && deadline != Py_None) {
+        t = PyFloat_AsDouble(deadline);
+        if (t == -1.0 && PyErr_Occurred())
+            return -1;
+        if (Py_IS_NAN(t)) {
+            PyErr_SetString(PyExc_ValueError, "deadline must be a number");
+            return -1;
+        }
+        if (monotonic_func == NULL) {
+            PyObject *module = PyImport_ImportModule("time");
+            if (module == NULL)
+                return -1;
+            monotonic_func = PyObject_GetAttrString(module, "monotonic");
+            Py_DECREF(module);
+            if (monotonic_func == NULL)
+                return -1;
+        }
+        if ((now = PyObject_CallObject(monotonic_func, NULL)) == NULL)
+            return -1;
+        t -= PyFloat_AsDouble(now);
+        Py_DECREF(now);
+        if (PyErr_Occurred())
+            return -1;
+        if (!limited || t < remaining)
+            remaining = t;
+        limited = 1;
+    }
+    *result = 0.0;
+    if (limited) {
+        *result = clock_monotonic() + remaining;
+        if (*result <= 0.0)     /* 0 would mean no deadline */
+            *result = 1e-9;
+    }
+    return 0;
+}
+
+/* interrupt hook for picosat_set_interrupt(), the state is a pointer to
+   the deadline */
+static int deadline_passed(void *state)
+{
+    double deadline = *((double *) state);
+
+    return deadline > 0.0 && clock_monotonic() >= deadline;
+}
+
+/************************** Portfolio solving ***********************/
+
+/* In portfolio mode, several picosat instances, each configured
+   differently, solve the same clauses on their own native threads.  The
+   first instance to find an answer wins, and the others are stopped
+   through their interrupt hook, which picosat calls every INTERRUPTLIM
+   decisions.  The worker threads never touch Python objects.
+
+   When clause sharing is enabled, the workers also cooperate: short and
+   low glue learned clauses are exported into a ring buffer, from which
+   the other workers import them whenever they are on decision level zero
+   (at restarts).  Each record in the ring is the index of the exporting
+   worker, followed by the zero terminated clause.  Records wrap around
+   at the end of the ring, and a worker which has fallen behind by more
+   than the size of the ring simply skips the overwritten clauses. */
+
+#define PORTFOLIO_MAX    64         /* instances (and threads) at most */
+#define SHARE_RING_SIZE  (1 << 20)  /* ints in the ring buffer */
+#define SHARE_MAX_SIZE   8          /* export clauses up to this size */
+#define SHARE_MAX_GLUE   2          /* ... or up to this glue */
+
+typedef struct {
+    PyThread_type_lock lock;    /* protects winner and running */
+    PyThread_type_lock done;    /* released when the last worker finishes */
+    int winner;                 /* index of first worker done, or -1 */
+    int running;                /* number of workers still running */
+    double deadline;            /* see get_deadline() */
+    /* clause sharing */
+    PyThread_type_lock ring_lock;  /* protects ring and head */
+    int *ring;                  /* NULL unless sharing */
+    unsigned long long head;    /* number of ints written to the ring */
+} portfolio_t;
+
+typedef struct {
+    PicoSAT *picosat;
+    const int *stream;          /* the clauses, shared by all workers */
+    Py_ssize_t n;
+    int index;
+    int res;
+    portfolio_t *shared;
+    /* clause sharing */
+    unsigned long long pos;     /* ints read from the ring so far */
+    int *imported;              /* clauses fetched from the ring */
+    size_t nimported, size;     /* number of, and room for ints */
+    size_t next;                /* next clause to hand to picosat */
+    int fetched;                /* handing out fetched clauses */
+} worker_t;
+
+/* restart units of the workers, in conflicts (picosat's default is 100) */
+static const unsigned restart_units[] = {100, 50, 300, 25, 1000};
+
+/* configure the picosat object of the i-th worker */
+static void configure_worker(PicoSAT *picosat, int i)
+{
+    int nunits = (int) (sizeof(restart_units) / sizeof(unsigned));
+
+    if (i == 0)                 /* the first worker uses the defaults */
+        return;
+    picosat_set_seed(picosat, (unsigned) i);
+    /* cycle through Jeroslow-Wang, false, true and random initial phase */
+    picosat_set_global_default_phase(picosat, (2 + i) % 4);
+    picosat_set_restart_unit(picosat, restart_units[(i / 4) % nunits]);
+}
+
+/* Picosat calls this every INTERRUPTLIM decisions only, so taking the
+   lock to read the winner costs next to nothing. */
+static int worker_interrupted(void *state)
+{
+    portfolio_t *shared = (portfolio_t *) state;
+    int winner;
+
+    PyThread_acquire_lock(shared->lock, WAIT_LOCK);
+    winner = shared->winner;
+    PyThread_release_lock(shared->lock);
+    return winner >= 0 || deadline_passed(&shared->deadline);
+}
+
+static void worker_export(void *state, const int *lits, int size,
+                          unsigned glue)
+{
+    worker_t *w = (worker_t *) state;
+    portfolio_t *shared = w->shared;
+    int i;
+
+    if (size + 2 > SHARE_RING_SIZE)
+        return;
+    PyThread_acquire_lock(shared->ring_lock, WAIT_LOCK);
+    shared->ring[shared->head++ % SHARE_RING_SIZE] = w->index;
+    for (i = 0; i <= size; i++)
+        shared->ring[shared->head++ % SHARE_RING_SIZE] = lits[i];
+    PyThread_release_lock(shared->ring_lock);
+}
+
+/* copy the clauses exported by the other workers from the ring into the
+   worker's import buffer */
+static void worker_fetch(worker_t *w)
+{
+    portfolio_t *shared = w->shared;
+    int *tmp, from, lit;
+    size_t n, size;
+
+    w->nimported = w->next = 0;
+    PyThread_acquire_lock(shared->ring_lock, WAIT_LOCK);
+    if (shared->head - w->pos > SHARE_RING_SIZE)
+        w->pos = shared->head;  /* too far behind, skip overwritten */
+    n = (size_t) (shared->head - w->pos);
+    if (n > w->size) {
+        size = n + 1024;
+        tmp = PyMem_RawRealloc(w->imported, size * sizeof(int));
+        if (tmp == NULL) {      /* just do not import anything */
+            w->pos = shared->head;
+            PyThread_release_lock(shared->ring_lock);
+            return;
+        }
+        w->imported = tmp;
+        w->size = size;
+    }
+    while (w->pos < shared->head) {
+        from = shared->ring[w->pos++ % SHARE_RING_SIZE];
+        do {
+            lit = shared->ring[w->pos++ % SHARE_RING_SIZE];
+            if (from != w->index)
+                w->imported[w->nimported++] = lit;
+        } while (lit);
+    }
+    PyThread_release_lock(shared->ring_lock);
+}
+
+static const int *worker_import(void *state)
+{
+    worker_t *w = (worker_t *) state;
+    const int *clause;
+
+    if (w->next == w->nimported) {
+        if (w->fetched) {       /* all fetched clauses were handed out */
+            w->fetched = 0;
+            return NULL;
+        }
+        worker_fetch(w);
+        if (w->nimported == 0)
+            return NULL;
+        w->fetched = 1;
+    }
+    clause = w->imported + w->next;
+    while (w->imported[w->next++])
+        ;
+    return clause;
+}
+
+static void worker_finish(worker_t *w)
+{
+    portfolio_t *shared = w->shared;
+    int last;
+
+    PyThread_acquire_lock(shared->lock, WAIT_LOCK);
+    if (w->res != PICOSAT_UNKNOWN && shared->winner < 0)
+        shared->winner = w->index;
+    last = --shared->running == 0;
+    PyThread_release_lock(shared->lock);
+    /* shared may be gone as soon as done is released */
+    if (last)
+        PyThread_release_lock(shared->done);
+}
+
+static void worker_run(void *arg)
+{
+    worker_t *w = (worker_t *) arg;
+
+    picosat_add_clauses(w->picosat, w->stream, (size_t) w->n);
+    if (!worker_interrupted(w->shared))
+        w->res = picosat_sat(w->picosat, -1);
+    worker_finish(w);
+}
+
+/* Solve the clauses with a portfolio of n picosat objects (which share
+   learned clauses when share is true), and return the result of the
+   winner, just like solve(). */
+static PyObject* solve_portfolio(PyObject *clauses, int n, int share,
+                                 int vars, int verbose,
+                                 unsigned long long prop_limit,
+                                 double deadline, int output)
+{
+    portfolio_t shared;
+    worker_t *workers;
+    PyObject *result = NULL;
+    int *stream;
+    Py_ssize_t len;
+    char prefix[32];
+    int i, started;
+
+    if ((stream = get_stream(clauses, &len)) == NULL)
+        return NULL;
+
+    memset(&shared, 0, sizeof(shared));
+    workers = PyMem_Malloc(n * sizeof(worker_t));
+    shared.lock = PyThread_allocate_lock();
+    shared.done = PyThread_allocate_lock();
+    if (share) {
+        shared.ring_lock = PyThread_allocate_lock();
+        shared.ring = PyMem_RawMalloc(SHARE_RING_SIZE * sizeof(int));
+    }
+    if (workers == NULL || shared.lock == NULL || shared.done == NULL ||
+            (share && (shared.ring_lock == NULL || shared.ring == NULL))) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    shared.winner = -1;
+    shared.running = n;
+    shared.deadline = deadline;
+
+    for (i = 0; i < n; i++) {
+        worker_t *w = workers + i;
+
+        w->picosat = new_picosat(vars, verbose, prop_limit);
+        w->stream = stream;
+        w->n = len;
+        w->index = i;
+        w->res = PICOSAT_UNKNOWN;
+        w->shared = &shared;
+        w->pos = 0;
+        w->imported = NULL;
+        w->nimported = w->size = w->next = 0;
+        w->fetched = 0;
+        configure_worker(w->picosat, i);
+        picosat_set_interrupt(w->picosat, &shared, worker_interrupted);
+        if (share) {
+            picosat_set_clause_export(w->picosat, w, worker_export,
+                                      SHARE_MAX_SIZE, SHARE_MAX_GLUE);
+            picosat_set_clause_import(w->picosat, w, worker_import);
+        }
+        if (verbose) {
+            sprintf(prefix, "c [%d] ", i);
+            picosat_set_prefix(w->picosat, prefix);
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    PyThread_acquire_lock(shared.done, WAIT_LOCK);
+    for (started = 1; started < n; started++)
+        if (PyThread_start_new_thread(worker_run, workers + started) ==
+                (unsigned long) -1)
+            break;
+    /* workers which could not be started are finished right away */
+    for (i = started; i < n; i++)
+        worker_finish(workers + i);
+    /* the first worker runs on this thread */
+    worker_run(workers);
+    PyThread_acquire_lock(shared.done, WAIT_LOCK);
+    PyThread_release_lock(shared.done);
+    Py_END_ALLOW_THREADS
+
+    if (shared.winner < 0)
+        result = PyUnicode_FromString("UNKNOWN");
+    else
+        result = get_result(workers[shared.winner].picosat,
+                            workers[shared.winner].res, output);
+
+    for (i = 0; i < n; i++) {
+        picosat_reset(workers[i].picosat);
+        PyMem_RawFree(workers[i].imported);
+    }
+
+done:
+    if (shared.lock)
+        PyThread_free_lock(shared.lock);
+    if (shared.done)
+        PyThread_free_lock(shared.done);
+    if (shared.ring_lock)
+        PyThread_free_lock(shared.ring_lock);
+    PyMem_RawFree(shared.ring);
+    PyMem_Free(workers);
+    PyMem_RawFree(stream);
+    return result;
+}
+
+/**************************** Solving *******************************/
+
+static PyObject* solve(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    PicoSAT *picosat;
+    PyObject *clauses;          /* iterable of clauses */
+    PyObject *result;           /* return value */
+    PyObject *timeout = NULL, *deadline_obj = NULL;
+    int vars = -1, verbose = 0, output, res, portfolio = 1, share = 0;
+    unsigned long long prop_limit = 0;
+    double deadline;
+    const char *output_name = NULL;
+    static char* kwlist[] = {"clauses",
+                             "vars", "verbose", "prop_limit", "output",
+                             "portfolio", "share", "timeout", "deadline",
+                             NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iiKziiOO:solve", kwlist,
+                                     &clauses,
+                                     &vars, &verbose, &prop_limit,
+                                     &output_name, &portfolio, &share,
+                                     &timeout, &deadline_obj))
+        return NULL;
+
+    if ((output = get_output(output_name)) < 0)
+        return NULL;
+
+    if (get_deadline(timeout, deadline_obj, &deadline) < 0)
+        return NULL;
+
+    if (portfolio < 1 || portfolio > PORTFOLIO_MAX) {
+        PyErr_Format(PyExc_ValueError, "portfolio size must be between "
+                     "1 and %d", PORTFOLIO_MAX);
+        return NULL;
+    }
+    if (portfolio > 1)
+        return solve_portfolio(clauses, portfolio, share, vars, verbose,
+                               prop_limit, deadline, output);
+
+    picosat = setup_picosat(add_clauses, clauses, vars, verbose,
+                            prop_limit);
+    if (picosat == NULL)
+        return NULL;
+    picosat_set_interrupt(picosat, &deadline, deadline_passed);
+
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    res = picosat_sat(picosat, -1);
+    Py_END_ALLOW_THREADS
+
+    result = get_result(picosat, res, output);
+    picosat_reset(picosat);
+    return result;
+}
+
+PyDoc_STRVAR(solve_doc,
+"solve(clauses [, kwargs]) -> list\n\
+\n\
+Solve the SAT problem for the clauses, and return a solution as a\n\
+list of integers, or one of the strings \"UNSAT\", \"UNKNOWN\".\n\
+Please see " PYCOSAT_URL " for more details.");
+
+static PyObject* solve_file(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    PicoSAT *picosat;
+    PyObject *path;             /* DIMACS file */
+    PyObject *result;           /* return value */
+    PyObject *timeout = NULL, *deadline_obj = NULL;
+    int vars = -1, verbose = 0, output, res;
+    unsigned long long prop_limit = 0;
+    double deadline;
+    const char *output_name = NULL;
+    static char* kwlist[] = {"path",
+                             "vars", "verbose", "prop_limit", "output",
+                             "timeout", "deadline", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iiKzOO:solve_file",
+                                     kwlist, &path,
+                                     &vars, &verbose, &prop_limit,
+                                     &output_name, &timeout, &deadline_obj))
+        return NULL;
+
+    if ((output = get_output(output_name)) < 0)
+        return NULL;
+
+    /* the time spent reading the file counts as well */
+    if (get_deadline(timeout, deadline_obj, &deadline) < 0)
+        return NULL;
+
+    picosat = setup_picosat(load_dimacs, path, vars, verbose, prop_limit);
+    if (picosat == NULL)
+        return NULL;
+    picosat_set_interrupt(picosat, &deadline, deadline_passed);
+
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    res = picosat_sat(picosat, -1);
+    Py_END_ALLOW_THREADS
+
+    result = get_result(picosat, res, output);
+    picosat_reset(picosat);
+    return result;
+}
+
+PyDoc_STRVAR(solve_file_doc,
+"solve_file(path [, kwargs]) -> list\n\
+\n\
+Solve the SAT problem in the DIMACS CNF file (which may be gzip\n\
+compressed), and return a solution as a list of integers, or one of\n\
+the strings \"UNSAT\", \"UNKNOWN\".  The keyword arguments are the same\n\
+as for solve().");
+
+/*********************** Solution Iterator *********************/
+
+typedef struct {
+    PyObject_HEAD
+    PicoSAT *picosat;
+    signed char *mem;           /* temporary storage */
+    int output;                 /* output format of the solutions */
+    double deadline;            /* see get_deadline() */
+    int *project;               /* sorted variables to project onto, */
+    int nproject;               /* or NULL to enumerate full solutions */
+    int blocking;               /* BLOCK_DECISIONS or BLOCK_FULL */
+    int level;                  /* levels to block by picosat_next_model(),
+                                   or -1 to call picosat_sat() */
+    int cubes;                  /* yield partial solutions */
+    int batch;                  /* number of solutions found at once */
+    int chunks;                 /* yield chunks of solutions */
+    int done;                   /* no more solutions */
+} soliterobject;
+
+enum { BLOCK_DECISIONS, BLOCK_FULL };
+
+static PyTypeObject SolIter_Type;
+
+#define SolIter_Check(op)  PyObject_TypeCheck(op, &SolIter_Type)
+
+static int cmp_int(const void *a, const void *b)
+{
+    int x = *((const int *) a), y = *((const int *) b);
+
+    return (x > y) - (x < y);
+}
+
+/* Return the variables of the literals in obj as a new sorted array
+   (allocated using PyMem_Malloc) without duplicates, and store their
+   number in *pn. */
+static int* get_vars(PyObject *obj, int *pn)
+{
+    int stack[CLAUSE_STACK_SIZE], *lits, *vars;
+    Py_ssize_t n, i, j;
+
+    if ((n = get_lits(obj, stack, &lits)) < 0)
+        return NULL;
+    vars = PyMem_Malloc((n + 1) * sizeof(int));
+    if (vars == NULL) {
+        free_lits(lits, stack);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (i = 0; i < n; i++)
+        vars[i] = abs(lits[i]);
+    free_lits(lits, stack);
+
+    qsort(vars, (size_t) n, sizeof(int), cmp_int);
+    for (i = j = 0; i < n; i++)
+        if (j == 0 || vars[j - 1] != vars[i])
+            vars[j++] = vars[i];
+    *pn = (int) j;
+    return vars;
+}
+
+static int get_blocking(const char *name)
+{
+    if (name == NULL || strcmp(name, "decisions") == 0)
+        return BLOCK_DECISIONS;
+    if (strcmp(name, "full") == 0)
+        return BLOCK_FULL;
+
+    PyErr_Format(PyExc_ValueError, "blocking must be 'decisions' or "
+                 "'full', got '%s'", name);
+    return -1;
+}
+
+/* Return a new solution iterator for the clauses, or NULL with an
+   exception set.  The arguments are those of itersolve(), except that the
+   output format and the deadline are already translated. */
+static soliterobject* new_soliter(PyObject *clauses, int vars, int verbose,
+                                  unsigned long long prop_limit, int output,
+                                  double deadline, PyObject *project_obj,
+                                  const char *blocking_name, int cubes,
+                                  int batch)
+{
+    soliterobject *it;
+    PicoSAT *picosat;
+    signed char *mem;
+    int *project = NULL, nproject = 0;
+    int blocking, i;
+
+    if (batch < 0) {
+        PyErr_SetString(PyExc_ValueError, "batch must not be negative");
+        return NULL;
+    }
+
+    if ((blocking = get_blocking(blocking_name)) < 0)
+        return NULL;
+
+    if (cubes) {
+        /* a cube leaves variables unassigned, which neither "bitset" nor
+           "positive" can tell apart from false ones */
+        if (output != OUTPUT_LIST && output != OUTPUT_ARRAY) {
+            PyErr_SetString(PyExc_ValueError,
+                            "output must be 'list' or 'array' for cubes");
+            return NULL;
+        }
+        /* a cube is blocked by the clause of all its literals */
+        if (blocking_name != NULL && blocking != BLOCK_FULL) {
+            PyErr_SetString(PyExc_ValueError,
+                            "blocking must be 'full' for cubes");
+            return NULL;
+        }
+        blocking = BLOCK_FULL;
+    }
+
+    if (project_obj != NULL && project_obj != Py_None &&
+            (project = get_vars(project_obj, &nproject)) == NULL)
+        return NULL;
+
+    picosat = new_picosat(vars, verbose, prop_limit);
+    /* picosat_deref_partial() needs the original clauses */
+    if (cubes)
+        picosat_save_original_clauses(picosat);
+    picosat = load_picosat(picosat, add_clauses, clauses, verbose);
+    if (picosat == NULL) {
+        PyMem_Free(project);
+        return NULL;
+    }
+    /* projected variables, which do not occur in any clause, are free */
+    if (nproject && project[nproject - 1] > picosat_variables(picosat))
+        picosat_adjust(picosat, project[nproject - 1]);
+    /* decide on the projected variables first, such that the other
+       decisions can be left out of the blocking clauses */
+    if (blocking == BLOCK_DECISIONS)
+        for (i = 0; i < nproject; i++)
+            picosat_set_more_important_lit(picosat, project[i]);
+
+    /* room for the values of batch solutions */
+    if ((size_t) (batch ? batch : 1) >
+            (size_t) PY_SSIZE_T_MAX / (picosat_variables(picosat) + 1))
+        mem = NULL;
+    else if ((mem = PyMem_Malloc((size_t) (batch ? batch : 1) *
+                                 (picosat_variables(picosat) + 1))) != NULL)
+        memset(mem, 0, (size_t) (batch ? batch : 1) *
+                       (picosat_variables(picosat) + 1));
+    if (mem == NULL) {
+        PyMem_Free(project);
+        picosat_reset(picosat);
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    it = PyObject_GC_New(soliterobject, &SolIter_Type);
+    if (it == NULL) {
+        PyMem_Free(project);
+        PyMem_Free(mem);
+        picosat_reset(picosat);
+        return NULL;
+    }
+    it->picosat = picosat;
+    it->mem = mem;
+    it->output = output;
+    it->deadline = deadline;
+    it->project = project;
+    it->nproject = nproject;
+    it->blocking = blocking;
+    it->level = -1;
+    it->cubes = cubes;
+    it->batch = batch ? batch : 1;
+    it->chunks = batch != 0;
+    it->done = 0;
+    picosat_set_interrupt(picosat, &it->deadline, deadline_passed);
+
+    PyObject_GC_Track(it);
+    return it;
+}
+
+static PyObject* itersolve(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *clauses;          /* iterable of clauses */
+    PyObject *timeout = NULL, *deadline_obj = NULL;
+    PyObject *project_obj = NULL;
+    int vars = -1, verbose = 0, output, cubes = 0, batch = 0;
+    unsigned long long prop_limit = 0;
+    double deadline;
+    const char *output_name = NULL, *blocking_name = NULL;
+    static char* kwlist[] = {"clauses",
+                             "vars", "verbose", "prop_limit", "output",
+                             "timeout", "deadline", "project", "blocking",
+                             "cubes", "batch", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iiKzOOOzii:itersolve",
+                                     kwlist, &clauses,
+                                     &vars, &verbose, &prop_limit,
+                                     &output_name, &timeout, &deadline_obj,
+                                     &project_obj, &blocking_name, &cubes,
+                                     &batch))
+        return NULL;
+
+    if ((output = get_output(output_name)) < 0)
+        return NULL;
+
+    if (get_deadline(timeout, deadline_obj, &deadline) < 0)
+        return NULL;
+
+    return (PyObject *) new_soliter(clauses, vars, verbose, prop_limit,
+                                    output, deadline, project_obj,
+                                    blocking_name, cubes, batch);
+}
+
+PyDoc_STRVAR(itersolve_doc,
+"itersolve(clauses [, kwargs]) -> iterator\n\
+\n\
+Solve the SAT problem for the clauses, and return an iterator over\n\
+the solutions (which are lists of integers).  When project is given\n\
+(an iterable of variables), the solutions are projected onto these\n\
+variables, and each distinct projection is returned once.\n\
+When cubes is true, partial solutions are returned, which leave out the\n\
+variables whose values do not matter, such that each solution of the\n\
+clauses extends exactly one of them.\n\
+When batch is given, up to batch solutions are found at once, and\n\
+returned together as one chunk (a 2-D memoryview for the 'array' and\n\
+'bitset' output, or a list of solutions).\n\
+By default, each solution is excluded from the search by a clause of\n\
+its decisions only (blocking='decisions'); blocking='full' uses all of\n\
+its literals instead.\n\
+Please see " PYCOSAT_URL " for more details.");
+
+/* The current solution is blocked by the negation of its decisions, since
+   all other literals are implied by them.  With a projection, only the
+   decisions up to the level on which the last projected variable was
+   assigned are needed, but these must all be on projected variables
+   (which are therefore decided first).  Return the number of decision
+   levels to block, or -1 when this is not the case (e.g. after a random
+   decision), and the solution has to be blocked by blocksol() instead.
+   Requires vals to hold the projected solution. */
+static int blocking_level(soliterobject *it, const signed char *vals)
+{
+    const int *decs;
+    int i, l, level = 0;
+
+    decs = picosat_decision_literals(it->picosat);
+    if (it->project == NULL) {
+        while (decs[level])
+            level++;
+        return level;
+    }
+    for (i = 0; i < it->nproject; i++)
+        if ((l = picosat_deref_level(it->picosat, it->project[i])) > level)
+            level = l;
+    for (i = 0; i < level; i++)
+        if (vals[abs(decs[i])] == 0)
+            return -1;
+    return level;
+}
+
+/* Clear the values of all variables in vals[1..max_idx] which are not in
+   the sorted array project[0..nproject-1]. */
+static void project_values(signed char *vals, int max_idx,
+                           const int *project, int nproject)
+{
+    int i, j = 0;
+
+    for (i = 1; i <= max_idx; i++) {
+        while (j < nproject && project[j] < i)
+            j++;
+        if (j == nproject || project[j] != i)
+            vals[i] = 0;
+    }
+}
+
+/* Find the next solution, store its values in vals[0..max_idx], and
+   block it.  Does not need the GIL.  Return the picosat result. */
+static int soliter_find(soliterobject *it, signed char *vals)
+{
+    int res, max_idx, i;
+
+    if (it->level < 0)
+        res = picosat_sat(it->picosat, -1);
+    else  /* backtrack from the last solution, instead of restarting */
+        res = picosat_next_model(it->picosat, it->level, -1);
+    it->level = -1;
+    if (res != PICOSAT_SATISFIABLE)
+        return res;
+
+    max_idx = picosat_variables(it->picosat);
+    if (it->cubes) {
+        /* the partial assignment also satisfies the clauses blocking
+           the previous cubes, so the cubes are disjoint */
+        memset(vals, 0, max_idx + 1);
+        for (i = 1; i <= max_idx; i++)
+            vals[i] = (signed char) picosat_deref_partial(it->picosat, i);
+        if (it->project)
+            project_values(vals, max_idx, it->project, it->nproject);
+    }
+    else if (it->project) {
+        memset(vals, 0, max_idx + 1);
+        for (i = 0; i < it->nproject; i++)
+            vals[it->project[i]] =
+                (signed char) picosat_deref(it->picosat, it->project[i]);
+    }
+    else {
+        get_values(it->picosat, vals, max_idx);
+    }
+    /* add inverse solution to the clauses, for next iteration */
+    if (it->blocking == BLOCK_DECISIONS &&
+            (it->level = blocking_level(it, vals)) >= 0)
+        return res;
+    blocksol(it->picosat, vals);
+    return res;
+}
+
+/* Return the n solutions in it->mem (each of which takes max_idx + 1
+   bytes) as one chunk: a 2-D memoryview of ints (one row of literals per
+   solution) for the "array" output, a 2-D memoryview of bytes (one bitset
+   per solution) for the "bitset" output, and a list of solutions
+   otherwise (or when the rows would be empty). */
+static PyObject* new_chunk(soliterobject *it, int n, int max_idx)
+{
+    PyObject *buf, *view, *res, *sol;
+    Py_ssize_t width = 0, size = 0;
+    const signed char *vals;
+    int i, j, k, *lits;
+    unsigned char *bits;
+
+#ifdef IS_PY3K
+    if (it->output == OUTPUT_ARRAY && !it->cubes) {
+        width = it->project ? it->nproject : max_idx;
+        size = sizeof(int);
+    }
+    if (it->output == OUTPUT_BITSET) {
+        width = (max_idx + 7) / 8;
+        size = 1;
+    }
+#endif
+    if (width == 0) {
+        if ((res = PyList_New(n)) == NULL)
+            return NULL;
+        for (i = 0; i < n; i++) {
+            sol = new_solution(it->mem + (size_t) i * (max_idx + 1),
+                               max_idx, it->output);
+            if (sol == NULL) {
+                Py_DECREF(res);
+                return NULL;
+            }
+            PyList_SET_ITEM(res, i, sol);
+        }
+        return res;
+    }
+
+    buf = PyByteArray_FromStringAndSize(NULL, n * width * size);
+    if (buf == NULL)
+        return NULL;
+    lits = (int *) PyByteArray_AS_STRING(buf);
+    bits = (unsigned char *) PyByteArray_AS_STRING(buf);
+    memset(bits, 0, n * width * size);
+    for (i = 0; i < n; i++) {
+        vals = it->mem + (size_t) i * (max_idx + 1);
+        for (j = 1, k = 0; j <= max_idx; j++) {
+            if (it->output == OUTPUT_ARRAY) {
+                if (vals[j])
+                    lits[i * width + k++] = vals[j] * j;
+            }
+            else if (vals[j] > 0) {
+                bits[i * width + ((j - 1) >> 3)] |= 1 << ((j - 1) & 7);
+            }
+        }
+    }
+    view = PyMemoryView_FromObject(buf);
+    Py_DECREF(buf);
+    if (view == NULL)
+        return NULL;
+    res = PyObject_CallMethod(view, "cast", "s(nn)",
+                              size == 1 ? "B" : "i", (Py_ssize_t) n, width);
+    Py_DECREF(view);
+    return res;
+}
+
+static PyObject* soliter_next(soliterobject *it)
+{
+    int res = PICOSAT_UNKNOWN, max_idx, n = 0;
+
+    assert(SolIter_Check(it));
+
+    if (it->done)
+        return NULL;
+
+    max_idx = picosat_variables(it->picosat);
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    while (n < it->batch) {
+        res = soliter_find(it, it->mem + (size_t) n * (max_idx + 1));
+        if (res != PICOSAT_SATISFIABLE)
+            break;
+        n++;
+    }
+    Py_END_ALLOW_THREADS
+
+    switch (res) {
+    case PICOSAT_SATISFIABLE:
+        break;
+
+    case PICOSAT_UNSATISFIABLE:
+    case PICOSAT_UNKNOWN:
+        /* no more solutions -- stop iteration (after this chunk) */
+        it->done = 1;
+        break;
+
+    default:
+        it->done = 1;
+        PyErr_Format(PyExc_SystemError, "picosat return value: %d", res);
+        return NULL;
+    }
+    if (n == 0)
+        return NULL;
+    if (it->chunks)
+        return new_chunk(it, n, max_idx);
+    return new_solution(it->mem, max_idx, it->output);
+}
+
+static void soliter_dealloc(soliterobject *it)
+{
+    PyObject_GC_UnTrack(it);
+    if (it->mem)
+        PyMem_Free(it->mem);
+    PyMem_Free(it->project);
+    picosat_reset(it->picosat);
+    PyObject_GC_Del(it);
+}
+
+static int soliter_traverse(soliterobject *it, visitproc visit, void *arg)
+{
+    return 0;
+}
+
+static PyTypeObject SolIter_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "soliterator",                            /* tp_name */
+    sizeof(soliterobject),                    /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    /* methods */
+    (destructor) soliter_dealloc,             /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    0,                                        /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    PyObject_GenericGetAttr,                  /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,  /* tp_flags */
+    0,                                        /* tp_doc */
+    (traverseproc) soliter_traverse,          /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    PyObject_SelfIter,                        /* tp_iter */
+    (iternextfunc) soliter_next,              /* tp_iternext */
+    0,                                        /* tp_methods */
+};
+
+/*********************** Enumerating into files *********************/
+
+#define WRITE_BUFFER_SIZE  (1 << 20)
+
+/* The formats of the solutions written by enumerate_to() */
+enum {
+    FORMAT_DIMACS = 0,          /* literals of each solution, and a 0 */
+    FORMAT_BITSET,              /* bitset of each solution, as "bitset" */
+};
+
+typedef struct {
+    int fd;
+    char *buf;
+    size_t size;                /* size of buf */
+    size_t n;                   /* number of bytes in buf */
+    int error;                  /* errno of a failed write, or 0 */
+} writer_t;
+
+/* Write the buffer to the file.  Does not need the GIL. */
+static void writer_flush(writer_t *w)
+{
+    size_t done = 0;
+    long k;
+
+    while (done < w->n && !w->error) {
+        k = (long) write(w->fd, w->buf + done, (unsigned) (w->n - done));
+        if (k >= 0)
+            done += (size_t) k;
+        else if (errno != EINTR)
+            w->error = errno;
+    }
+    w->n = 0;
+}
+
+/* Append the solution in vals[1..max_idx] to the buffer, which is flushed
+   when needed.  Does not need the GIL. */
+static void writer_solution(writer_t *w, const signed char *vals,
+                            int max_idx, int format)
+{
+    char digits[12], *p;
+    unsigned char *bits;
+    size_t need;
+    unsigned u;
+    int i, k;
+
+    /* at most 11 characters and a space for each literal, and "0\n" */
+    need = format == FORMAT_DIMACS ? 12 * (size_t) max_idx + 2 :
+                                     (size_t) (max_idx + 7) / 8;
+    if (w->n + need > w->size)
+        writer_flush(w);
+
+    if (format == FORMAT_BITSET) {
+        bits = (unsigned char *) w->buf + w->n;
+        memset(bits, 0, need);
+        for (i = 1; i <= max_idx; i++)
+            if (vals[i] > 0)
+                bits[(i - 1) >> 3] |= 1 << ((i - 1) & 7);
+        w->n += need;
+        return;
+    }
+
+    p = w->buf + w->n;
+    for (i = 1; i <= max_idx; i++) {
+        if (vals[i] == 0)
+            continue;
+        if (vals[i] < 0)
+            *p++ = '-';
+        u = (unsigned) i;
+        k = 0;
+        do {
+            digits[k++] = (char) ('0' + u % 10);
+            u /= 10;
+        } while (u);
+        while (k)
+            *p++ = digits[--k];
+        *p++ = ' ';
+    }
+    *p++ = '0';
+    *p++ = '\n';
+    w->n = p - w->buf;
+}
+
+static PyObject* enumerate_to(PyObject *self, PyObject *args,
+                              PyObject *kwds)
+{
+    soliterobject *it;
+    PyObject *file, *clauses, *bytes = NULL;
+    PyObject *timeout = NULL, *deadline_obj = NULL, *project_obj = NULL;
+    int vars = -1, verbose = 0, cubes = 0, format, res, max_idx;
+    unsigned long long prop_limit = 0, limit = 0, count = 0;
+    double deadline;
+    const char *format_name = NULL;
+    writer_t w;
+    static char* kwlist[] = {"file", "clauses", "format", "limit",
+                             "vars", "verbose", "prop_limit",
+                             "timeout", "deadline", "project", "cubes",
+                             NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|zKiiKOOOi:enumerate_to",
+                                     kwlist, &file, &clauses,
+                                     &format_name, &limit,
+                                     &vars, &verbose, &prop_limit,
+                                     &timeout, &deadline_obj, &project_obj,
+                                     &cubes))
+        return NULL;
+
+    if (format_name == NULL || strcmp(format_name, "dimacs") == 0)
+        format = FORMAT_DIMACS;
+    else if (strcmp(format_name, "bitset") == 0)
+        format = FORMAT_BITSET;
+    else {
+        PyErr_Format(PyExc_ValueError, "format must be 'dimacs' or "
+                     "'bitset', got '%s'", format_name);
+        return NULL;
+    }
+    if (cubes && format != FORMAT_DIMACS) {
+        PyErr_SetString(PyExc_ValueError,
+                        "format must be 'dimacs' for cubes");
+        return NULL;
+    }
+
+    if (get_deadline(timeout, deadline_obj, &deadline) < 0)
+        return NULL;
+
+    /* a file descriptor is written to as is, a path is opened */
+    w.fd = -1;
+    if (IS_INT(file)) {
+        w.fd = (int) PyLong_AsLong(file);
+        if (w.fd == -1 && PyErr_Occurred())
+            return NULL;
+    }
+    else if (!PyUnicode_FSConverter(file, &bytes))
+        return NULL;
+
+    it = new_soliter(clauses, vars, verbose, prop_limit,
+                     format == FORMAT_DIMACS ? OUTPUT_ARRAY : OUTPUT_BITSET,
+                     deadline, project_obj, NULL, cubes, 0);
+    if (it == NULL) {
+        Py_XDECREF(bytes);
+        return NULL;
+    }
+    max_idx = picosat_variables(it->picosat);
+
+    w.size = 12 * (size_t) max_idx + 2;
+    if (w.size < WRITE_BUFFER_SIZE)
+        w.size = WRITE_BUFFER_SIZE;
+    w.buf = PyMem_Malloc(w.size);
+    if (w.buf == NULL) {
+        Py_XDECREF(bytes);
+        Py_DECREF(it);
+        return PyErr_NoMemory();
+    }
+    w.n = 0;
+    w.error = 0;
+
+    if (bytes) {
+        w.fd = open(PyBytes_AS_STRING(bytes),
+                    O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+        if (w.fd < 0) {
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, file);
+            Py_DECREF(bytes);
+            PyMem_Free(w.buf);
+            Py_DECREF(it);
+            return NULL;
+        }
+    }
+
+    res = PICOSAT_SATISFIABLE;
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    while ((limit == 0 || count < limit) && !w.error) {
+        res = soliter_find(it, it->mem);
+        if (res != PICOSAT_SATISFIABLE)
+            break;
+        writer_solution(&w, it->mem, max_idx, format);
+        count++;
+    }
+    writer_flush(&w);
+    if (bytes && close(w.fd) < 0 && !w.error)
+        w.error = errno;
+    Py_END_ALLOW_THREADS
+
+    PyMem_Free(w.buf);
+    Py_DECREF(it);
+    if (w.error) {
+        errno = w.error;
+        if (bytes)
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, file);
+        else
+            PyErr_SetFromErrno(PyExc_OSError);
+        Py_XDECREF(bytes);
+        return NULL;
+    }
+    Py_XDECREF(bytes);
+
+    switch (res) {
+    case PICOSAT_SATISFIABLE:
+    case PICOSAT_UNSATISFIABLE:
+    case PICOSAT_UNKNOWN:
+        break;
+    default:
+        PyErr_Format(PyExc_SystemError, "picosat return value: %d", res);
+        return NULL;
+    }
+    return PyLong_FromUnsignedLongLong(count);
+}
+
+PyDoc_STRVAR(enumerate_to_doc,
+"enumerate_to(file, clauses [, kwargs]) -> int\n\
+\n\
+Write all solutions of the clauses to file (a path or a file\n\
+descriptor), and return their number.  The loop runs in C without the\n\
+GIL, and no Python objects are created for the solutions.  With\n\
+format='dimacs', each solution is written as a line of literals\n\
+terminated by 0, and with format='bitset', as a bitset of one bit for\n\
+each variable (like the 'bitset' output of itersolve).  At most limit\n\
+solutions are written, unless limit is 0.  The remaining arguments are\n\
+those of itersolve.\n\
+Please see " PYCOSAT_URL " for more details.");
+
+/*************************** Model counting *************************/
+
+/* An exact model counter (#SAT), which is a DPLL search with unit
+   propagation, splitting of the residual clauses into independent
+   (connected) components, and a cache of the counts of components.  The
+   count of a formula is the product of the counts of its components, so
+   that the search only has to branch within each of them, and the same
+   components come up again and again in different branches.  A component
+   is identified by its (unassigned) variables and its (unsatisfied)
+   clauses, which determine its residual clauses.  With a projection,
+   only projected variables are branched on, and a component without
+   projected variables counts 1 when it is satisfiable. */
+
+/* arbitrary precision unsigned integers, which are 0 when n == 0 */
+typedef struct {
+    uint32_t *d;                /* digits, least significant first */
+    int n;                      /* number of digits */
+    int size;                   /* allocated digits */
+} bigint_t;
+
+typedef struct cache_entry {
+    struct cache_entry *next;
+    unsigned hash;
+    int len;                    /* number of ints in key */
+    bigint_t count;
+    int key[1];                 /* variables and clauses of component */
+} cache_entry_t;
+
+/* The search is iterative, as it branches once per level, which would
+   overflow the C stack of a thread on long chains of variables.  Each
+   component being counted has a frame, which is in one of these states:
+   it is about to branch, or it is counting the components of a branch. */
+enum { FRAME_ENTER, FRAME_BRANCH, FRAME_SUBS };
+
+typedef struct {
+    int state;
+    size_t off;                 /* the component on the stack */
+    int len;                    /* its length (the cache key) */
+    unsigned hash;
+    int best, exists, sign;     /* branch variable, literal sign */
+    int ntrail;                 /* trail before the branch */
+    size_t top;                 /* stack before the branch */
+    size_t sub_off;             /* next component of the branch */
+    int k, ncomps;              /* components of the branch, counted */
+    bigint_t res;               /* count of the branches done */
+    bigint_t prod;              /* product of the components counted */
+} frame_t;
+
+typedef struct {
+    int max_var;
+    int nclauses;
+    int *lits;                  /* literals of clause i are at lits[start[i]] */
+    int *start;                 /* ..., each clause is terminated by 0 */
+    int *occs;                  /* clauses of literal l are at occs[ostart[..]] */
+    int *ostart;                /* ..., indexed by LIT_INDEX(l) */
+    signed char *vals;          /* current assignment */
+    char *projected;            /* variables which are counted */
+    int *trail, ntrail, qhead;  /* assigned literals, propagation queue */
+    unsigned *vmark, *cmark;    /* marks for the component search */
+    unsigned epoch;             /* current mark */
+    int *score;                 /* occurrences, for choosing a branch */
+    int *tvars, *tclauses;      /* scratch space for one component */
+    int *stack;                 /* blocks of components to be counted: */
+    size_t nstack, sstack;      /* nvars, vars..., nclauses, clauses... */
+    cache_entry_t **table;      /* cache of component counts */
+    size_t ntable, nentries, cache_bytes;
+    frame_t *frames;            /* of the components being counted, */
+    int nframes, sframes;       /* whose bigints are kept for reuse */
+    bigint_t ret, tmp;          /* count of a finished frame, scratch */
+    double deadline;            /* see get_deadline() */
+    unsigned long branches;
+    int interrupted;
+    int nomem;
+} counter_t;
+
+#define LIT_INDEX(lit)  (2 * abs(lit) + ((lit) < 0))
+#define CACHE_LIMIT  ((size_t) 1 << 28)        /* bytes */
+
+static int big_reserve(counter_t *c, bigint_t *a, int n)
+{
+    uint32_t *d;
+
+    if (n <= a->size)
+        return 0;
+    if ((d = realloc(a->d, n * sizeof(uint32_t))) == NULL) {
+        c->nomem = 1;
+        return -1;
+    }
+    a->d = d;
+    a->size = n;
+    return 0;
+}
+
+static int big_set(counter_t *c, bigint_t *a, uint32_t x)
+{
+    if (big_reserve(c, a, 1) < 0)
+        return -1;
+    a->d[0] = x;
+    a->n = x != 0;
+    return 0;
+}
+
+static int big_copy(counter_t *c, bigint_t *a, const bigint_t *b)
+{
+    if (big_reserve(c, a, b->n) < 0)
+        return -1;
+    memcpy(a->d, b->d, b->n * sizeof(uint32_t));
+    a->n = b->n;
+    return 0;
+}
+
+/* a += b */
+static int big_add(counter_t *c, bigint_t *a, const bigint_t *b)
+{
+    uint64_t carry = 0;
+    int i, n = a->n > b->n ? a->n : b->n;
+
+    if (big_reserve(c, a, n + 1) < 0)
+        return -1;
+    for (i = 0; i < n; i++) {
+        carry += (uint64_t) (i < a->n ? a->d[i] : 0) +
+                            (i < b->n ? b->d[i] : 0);
+        a->d[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    a->d[n] = (uint32_t) carry;
+    a->n = n + (carry != 0);
+    return 0;
+}
+
+/* a *= b, using t as scratch space */
+static int big_mul(counter_t *c, bigint_t *a, const bigint_t *b,
+                   bigint_t *t)
+{
+    uint64_t carry;
+    int i, j;
+
+    if (a->n == 0 || b->n == 0) {
+        a->n = 0;
+        return 0;
+    }
+    if (big_reserve(c, t, a->n + b->n) < 0)
+        return -1;
+    memset(t->d, 0, (a->n + b->n) * sizeof(uint32_t));
+    for (i = 0; i < a->n; i++) {
+        carry = 0;
+        for (j = 0; j < b->n; j++) {
+            carry += (uint64_t) a->d[i] * b->d[j] + t->d[i + j];
+            t->d[i + j] = (uint32_t) carry;
+            carry >>= 32;
+        }
+        t->d[i + b->n] = (uint32_t) carry;
+    }
+    t->n = a->n + b->n;
+    while (t->n && t->d[t->n - 1] == 0)
+        t->n--;
+    return big_copy(c, a, t);
+}
+
+/* a <<= k */
+static int big_shl(counter_t *c, bigint_t *a, int k)
+{
+    int i, words = k / 32, bits = k % 32;
+
+    if (a->n == 0 || k == 0)
+        return 0;
+    if (big_reserve(c, a, a->n + words + 1) < 0)
+        return -1;
+    a->d[a->n + words] = 0;
+    for (i = a->n - 1; i >= 0; i--) {
+        if (bits)
+            a->d[i + words + 1] |= a->d[i] >> (32 - bits);
+        a->d[i + words] = a->d[i] << bits;
+    }
+    for (i = 0; i < words; i++)
+        a->d[i] = 0;
+    a->n += words + 1;
+    while (a->n && a->d[a->n - 1] == 0)
+        a->n--;
+    return 0;
+}
+
+static PyObject* big_to_python(const bigint_t *a)
+{
+    PyObject *res;
+    char *hex, *p;
+    int i;
+
+    if (a->n == 0)
+        return PyInt_FromLong(0);
+    if ((hex = PyMem_Malloc(8 * a->n + 1)) == NULL)
+        return PyErr_NoMemory();
+    p = hex;
+    for (i = a->n - 1; i >= 0; i--) {
+        sprintf(p, "%08x", (unsigned) a->d[i]);
+        p += 8;
+    }
+    res = PyLong_FromString(hex, NULL, 16);
+    PyMem_Free(hex);
+    return res;
+}
+
+static void counter_assign(counter_t *c, int lit)
+{
+    c->vals[abs(lit)] = lit > 0 ? 1 : -1;
+    c->trail[c->ntrail++] = lit;
+}
+
+static void counter_undo(counter_t *c, int ntrail)
+{
+    while (c->ntrail > ntrail)
+        c->vals[abs(c->trail[--c->ntrail])] = 0;
+    c->qhead = ntrail;
+}
+
+/* Return 1 when the clause is satisfied by the current assignment. */
+static int counter_satisfied(counter_t *c, int i)
+{
+    const int *p;
+
+    for (p = c->lits + c->start[i]; *p; p++)
+        if (c->vals[abs(*p)] == (*p > 0 ? 1 : -1))
+            return 1;
+    return 0;
+}
+
+/* Propagate the literals on the trail.  Return 0 on a conflict. */
+static int counter_propagate(counter_t *c)
+{
+    const int *o, *eo, *p;
+    int lit, unit, unassigned, val;
+
+    while (c->qhead < c->ntrail) {
+        lit = -c->trail[c->qhead++];
+        o = c->occs + c->ostart[LIT_INDEX(lit)];
+        eo = c->occs + c->ostart[LIT_INDEX(lit) + 1];
+        for (; o < eo; o++) {
+            unit = unassigned = 0;
+            for (p = c->lits + c->start[*o]; *p; p++) {
+                val = c->vals[abs(*p)];
+                if (val == 0) {
+                    unit = *p;
+                    unassigned++;
+                }
+                else if (val == (*p > 0 ? 1 : -1))
+                    break;
+            }
+            if (*p)             /* satisfied */
+                continue;
+            if (unassigned == 0)
+                return 0;
+            if (unassigned == 1)
+                counter_assign(c, unit);
+        }
+    }
+    return 1;
+}
+
+/* Make room for n more ints on the component stack. */
+static int stack_reserve(counter_t *c, size_t n)
+{
+    int *stack;
+    size_t size;
+
+    if (c->nstack + n <= c->sstack)
+        return 0;
+    size = 2 * (c->nstack + n) + 1024;
+    if ((stack = realloc(c->stack, size * sizeof(int))) == NULL) {
+        c->nomem = 1;
+        return -1;
+    }
+    c->stack = stack;
+    c->sstack = size;
+    return 0;
+}
+
+/* Split the unassigned variables among vars[0..nvars-1] (found at offset
+   off of the stack) into components, which are pushed onto the stack.
+   Store the number of components in *ncomps, and the number of projected
+   variables which do not occur in any unsatisfied clause in *nfree. */
+static int decompose(counter_t *c, size_t off, int *ncomps, int *nfree)
+{
+    int i, j, k, v, w, n, nv, nc, lit;
+    const int *o, *eo, *p;
+    unsigned epoch = ++c->epoch;
+
+    *ncomps = *nfree = 0;
+    n = c->stack[off];
+    for (i = 0; i < n; i++) {
+        v = c->stack[off + 1 + i];
+        if (c->vals[v] || c->vmark[v] == epoch)
+            continue;
+        /* search the component of v */
+        c->vmark[v] = epoch;
+        c->tvars[0] = v;
+        nv = 1;
+        nc = 0;
+        for (j = 0; j < nv; j++) {
+            w = c->tvars[j];
+            for (k = 0; k < 2; k++) {
+                lit = k ? -w : w;
+                o = c->occs + c->ostart[LIT_INDEX(lit)];
+                eo = c->occs + c->ostart[LIT_INDEX(lit) + 1];
+                for (; o < eo; o++) {
+                    if (c->cmark[*o] == epoch)
+                        continue;
+                    c->cmark[*o] = epoch;
+                    if (counter_satisfied(c, *o))
+                        continue;
+                    c->tclauses[nc++] = *o;
+                    for (p = c->lits + c->start[*o]; *p; p++)
+                        if (c->vals[abs(*p)] == 0 &&
+                                c->vmark[abs(*p)] != epoch) {
+                            c->vmark[abs(*p)] = epoch;
+                            c->tvars[nv++] = abs(*p);
+                        }
+                }
+            }
+        }
+        if (nc == 0) {
+            *nfree += c->projected[v];
+            continue;
+        }
+        if (stack_reserve(c, nv + nc + 2) < 0)
+            return -1;
+        qsort(c->tvars, nv, sizeof(int), cmp_int);
+        qsort(c->tclauses, nc, sizeof(int), cmp_int);
+        c->stack[c->nstack++] = nv;
+        memcpy(c->stack + c->nstack, c->tvars, nv * sizeof(int));
+        c->nstack += nv;
+        c->stack[c->nstack++] = nc;
+        memcpy(c->stack + c->nstack, c->tclauses, nc * sizeof(int));
+        c->nstack += nc;
+        (*ncomps)++;
+    }
+    return 0;
+}
+
+static unsigned hash_key(const int *key, int len)
+{
+    unsigned h = 2166136261u;
+    int i;
+
+    for (i = 0; i < len; i++)
+        h = (h ^ (unsigned) key[i]) * 16777619u;
+    return h;
+}
+
+static void cache_clear(counter_t *c)
+{
+    cache_entry_t *e, *next;
+    size_t i;
+
+    for (i = 0; i < c->ntable; i++)
+        for (e = c->table[i]; e; e = next) {
+            next = e->next;
+            free(e->count.d);
+            free(e);
+        }
+    memset(c->table, 0, c->ntable * sizeof(cache_entry_t *));
+    c->nentries = c->cache_bytes = 0;
+}
+
+static cache_entry_t* cache_lookup(counter_t *c, const int *key, int len,
+                                   unsigned hash)
+{
+    cache_entry_t *e;
+
+    for (e = c->table[hash & (c->ntable - 1)]; e; e = e->next)
+        if (e->hash == hash && e->len == len &&
+                memcmp(e->key, key, len * sizeof(int)) == 0)
+            return e;
+    return NULL;
+}
+
+/* Add the count of a component to the cache, which is simply cleared
+   when it grows too large.  Failing to do so is not an error. */
+static void cache_insert(counter_t *c, const int *key, int len,
+                         unsigned hash, const bigint_t *count)
+{
+    cache_entry_t *e, **table, *next;
+    size_t i, bytes;
+
+    bytes = sizeof(cache_entry_t) + len * sizeof(int) +
+            count->n * sizeof(uint32_t);
+    if (c->cache_bytes + bytes > CACHE_LIMIT)
+        cache_clear(c);
+    if (c->nentries >= c->ntable &&
+            (table = calloc(2 * c->ntable, sizeof(cache_entry_t *)))) {
+        for (i = 0; i < c->ntable; i++)
+            for (e = c->table[i]; e; e = next) {
+                next = e->next;
+                e->next = table[e->hash & (2 * c->ntable - 1)];
+                table[e->hash & (2 * c->ntable - 1)] = e;
+            }
+        free(c->table);
+        c->table = table;
+        c->ntable *= 2;
+    }
+    if ((e = malloc(sizeof(cache_entry_t) + len * sizeof(int))) == NULL)
+        return;
+    e->hash = hash;
+    e->len = len;
+    memcpy(e->key, key, len * sizeof(int));
+    e->count.d = NULL;
+    e->count.n = e->count.size = 0;
+    if (count->n && (e->count.d = malloc(count->n * sizeof(uint32_t)))) {
+        memcpy(e->count.d, count->d, count->n * sizeof(uint32_t));
+        e->count.n = e->count.size = count->n;
+    }
+    else if (count->n) {
+        free(e);
+        return;
+    }
+    e->next = c->table[hash & (c->ntable - 1)];
+    c->table[hash & (c->ntable - 1)] = e;
+    c->nentries++;
+    c->cache_bytes += bytes;
+}
+
+/* Push a frame for the component at offset off of the stack, return -1
+   when out of memory. */
+static int frame_push(counter_t *c, size_t off)
+{
+    frame_t *frames, *f;
+    int n;
+
+    if (c->nframes == c->sframes) {
+        n = 2 * c->sframes + 64;
+        if ((frames = realloc(c->frames, n * sizeof(frame_t))) == NULL) {
+            c->nomem = 1;
+            return -1;
+        }
+        memset(frames + c->sframes, 0, (n - c->sframes) * sizeof(frame_t));
+        c->frames = frames;
+        c->sframes = n;
+    }
+    f = c->frames + c->nframes++;
+    f->state = FRAME_ENTER;
+    f->off = off;
+    return 0;
+}
+
+/* Set up the frame f for branching: look up its component in the cache,
+   and choose the variable to branch on.  Return 1 when the count was
+   found in the cache (and stored in c->ret), 0 otherwise, and -1 when out
+   of memory. */
+static int frame_enter(counter_t *c, frame_t *f)
+{
+    cache_entry_t *e;
+    int *comp, nv, nc, i, v, score, best_score;
+    const int *p;
+
+    comp = c->stack + f->off;
+    nv = comp[0];
+    nc = comp[1 + nv];
+    f->len = 2 + nv + nc;
+    f->hash = hash_key(comp, f->len);
+    if ((e = cache_lookup(c, comp, f->len, f->hash)) != NULL)
+        return big_copy(c, &c->ret, &e->count) < 0 ? -1 : 1;
+
+    /* Without projected variables, only satisfiability matters. */
+    f->exists = 1;
+    for (i = 0; i < nv; i++)
+        if (c->projected[comp[1 + i]]) {
+            f->exists = 0;
+            break;
+        }
+
+    /* branch on the (projected) variable with the most occurrences in
+       the clauses of the component */
+    for (i = 0; i < nc; i++)
+        for (p = c->lits + c->start[comp[2 + nv + i]]; *p; p++)
+            c->score[abs(*p)]++;
+    f->best = 0;
+    best_score = -1;
+    for (i = 0; i < nv; i++) {
+        v = comp[1 + i];
+        score = c->score[v];
+        if ((f->exists || c->projected[v]) && score > best_score) {
+            f->best = v;
+            best_score = score;
+        }
+    }
+    for (i = 0; i < nc; i++)
+        for (p = c->lits + c->start[comp[2 + nv + i]]; *p; p++)
+            c->score[abs(*p)] = 0;
+    assert(f->best);
+
+    f->sign = 1;
+    f->state = FRAME_BRANCH;
+    return big_set(c, &f->res, 0);
+}
+
+/* Count the models of the component at offset off of the stack, and
+   store the count in *res.  Return -1 when out of memory or interrupted.
+   Each branch splits the rest of the component into components, which
+   are counted one after the other (by frames above this one), and the
+   product of their counts is added to the count of the component. */
+static int count_component(counter_t *c, size_t off, bigint_t *res)
+{
+    frame_t *f;
+    int ncomps, nfree, r;
+
+    c->nframes = 0;
+    if (frame_push(c, off) < 0)
+        return -1;
+    while (c->nframes) {
+        f = c->frames + c->nframes - 1;
+        switch (f->state) {
+        case FRAME_ENTER:
+            if ((r = frame_enter(c, f)) < 0)
+                return -1;
+            if (r)              /* the count is in c->ret */
+                break;
+            continue;
+
+        case FRAME_BRANCH:
+            if (f->sign < -1 || (f->exists && f->res.n)) {
+                /* the component may have moved, when the stack grew */
+                cache_insert(c, c->stack + f->off, f->len, f->hash,
+                             &f->res);
+                if (big_copy(c, &c->ret, &f->res) < 0)
+                    return -1;
+                break;
+            }
+            if ((++c->branches & 1023) == 0 && c->deadline &&
+                    clock_monotonic() >= c->deadline) {
+                c->interrupted = 1;
+                return -1;
+            }
+            f->ntrail = c->ntrail;
+            counter_assign(c, f->sign * f->best);
+            if (!counter_propagate(c)) {
+                counter_undo(c, f->ntrail);
+                f->sign -= 2;
+                continue;
+            }
+            f->top = c->nstack;
+            if (decompose(c, f->off, &ncomps, &nfree) < 0 ||
+                    big_set(c, &f->prod, 1) < 0 ||
+                    big_shl(c, &f->prod, nfree) < 0)
+                return -1;
+            f->sub_off = f->top;
+            f->k = 0;
+            f->ncomps = ncomps;
+            f->state = FRAME_SUBS;
+            continue;
+
+        case FRAME_SUBS:
+            if (f->k < f->ncomps && f->prod.n) {
+                /* f may move when the frames grow */
+                if (frame_push(c, f->sub_off) < 0)
+                    return -1;
+                continue;
+            }
+            c->nstack = f->top;
+            if (big_add(c, &f->res, &f->prod) < 0)
+                return -1;
+            counter_undo(c, f->ntrail);
+            f->sign -= 2;
+            f->state = FRAME_BRANCH;
+            continue;
+        }
+
+        /* the count of the top frame is done, multiply it into the
+           product of the branch below, or return it */
+        if (--c->nframes == 0)
+            return big_copy(c, res, &c->ret);
+        f = c->frames + c->nframes - 1;
+        assert(f->state == FRAME_SUBS);
+        if (big_mul(c, &f->prod, &c->ret, &c->tmp) < 0)
+            return -1;
+        f->sub_off += 2 + c->stack[f->sub_off] +
+                      c->stack[f->sub_off + 1 + c->stack[f->sub_off]];
+        f->k++;
+    }
+    return 0;                   /* not reached */
+}
+
+static void counter_free(counter_t *c)
+{
+    int i;
+
+    for (i = 0; i < c->sframes; i++) {
+        free(c->frames[i].res.d);
+        free(c->frames[i].prod.d);
+    }
+    free(c->frames);
+    free(c->ret.d);
+    free(c->tmp.d);
+    if (c->table)
+        cache_clear(c);
+    free(c->table);
+    free(c->lits);
+    free(c->start);
+    free(c->occs);
+    free(c->ostart);
+    free(c->vals);
+    free(c->projected);
+    free(c->trail);
+    free(c->vmark);
+    free(c->cmark);
+    free(c->score);
+    free(c->tvars);
+    free(c->tclauses);
+    free(c->stack);
+}
+
+/* order literals by variable, negative before positive */
+static int cmp_lit(const void *a, const void *b)
+{
+    int x = *((const int *) a), y = *((const int *) b);
+
+    if (abs(x) != abs(y))
+        return (abs(x) > abs(y)) - (abs(x) < abs(y));
+    return (x > y) - (x < y);
+}
+
+/* Set up the counter for the zero terminated stream of n literals, where
+   duplicate literals and tautologies are removed, and the unit clauses
+   are propagated.  All variables are counted unless project is given.
+   Return 0 when the clauses are unsatisfiable, and -1 when out of
+   memory. */
+static int counter_init(counter_t *c, const int *stream, size_t n,
+                        int max_var, const int *project, int nproject)
+{
+    size_t i, j, k, begin, len;
+    int *p, *q, *pos, lit, empty = 0;
+
+    for (i = 0; i < n; i++)
+        if (abs(stream[i]) > max_var)
+            max_var = abs(stream[i]);
+    for (i = 0; i < (size_t) nproject; i++)
+        if (project[i] > max_var)
+            max_var = project[i];
+    c->max_var = max_var;
+
+    c->lits = malloc((n + 1) * sizeof(int));
+    c->start = malloc((n + 1) * sizeof(int));
+    c->ostart = calloc(2 * (size_t) max_var + 3, sizeof(int));
+    c->vals = calloc(max_var + 1, 1);
+    c->projected = calloc(max_var + 1, 1);
+    c->trail = malloc((max_var + 1) * sizeof(int));
+    c->vmark = calloc(max_var + 1, sizeof(unsigned));
+    c->score = calloc(max_var + 1, sizeof(int));
+    c->tvars = malloc((max_var + 1) * sizeof(int));
+    c->ntable = 1024;
+    c->table = calloc(c->ntable, sizeof(cache_entry_t *));
+    if (!c->lits || !c->start || !c->ostart || !c->vals || !c->projected ||
+            !c->trail || !c->vmark || !c->score || !c->tvars || !c->table)
+        return -1;
+
+    for (i = 1; i <= (size_t) max_var; i++)
+        c->projected[i] = project == NULL;
+    for (i = 0; i < (size_t) nproject; i++)
+        c->projected[project[i]] = 1;
+
+    /* copy the clauses without duplicate literals and tautologies */
+    for (i = k = begin = 0; i < n; i++) {
+        if (stream[i])
+            continue;
+        p = c->lits + k;
+        len = i - begin;
+        memcpy(p, stream + begin, len * sizeof(int));
+        begin = i + 1;
+        qsort(p, len, sizeof(int), cmp_lit);
+        for (j = 0, q = p; j < len; j++) {
+            if (q > p && q[-1] == p[j])
+                continue;
+            if (q > p && q[-1] == -p[j])
+                break;
+            *q++ = p[j];
+        }
+        if (j < len)            /* tautology */
+            continue;
+        if (q == p)
+            empty = 1;
+        *q++ = 0;
+        c->start[c->nclauses++] = (int) k;
+        k = q - c->lits;
+    }
+    if (empty)
+        return 0;
+
+    /* occurrence lists */
+    for (i = 0; i < (size_t) c->nclauses; i++)
+        for (p = c->lits + c->start[i]; *p; p++)
+            c->ostart[LIT_INDEX(*p) + 1]++;
+    for (i = 1; i <= 2 * (size_t) max_var + 2; i++)
+        c->ostart[i] += c->ostart[i - 1];
+    c->occs = malloc((c->ostart[2 * max_var + 2] + 1) * sizeof(int));
+    pos = malloc((2 * (size_t) max_var + 2) * sizeof(int));
+    c->cmark = calloc(c->nclauses + 1, sizeof(unsigned));
+    c->tclauses = malloc((c->nclauses + 1) * sizeof(int));
+    if (!c->occs || !pos || !c->cmark || !c->tclauses) {
+        free(pos);
+        return -1;
+    }
+    memcpy(pos, c->ostart, (2 * (size_t) max_var + 2) * sizeof(int));
+    for (i = 0; i < (size_t) c->nclauses; i++)
+        for (p = c->lits + c->start[i]; *p; p++)
+            c->occs[pos[LIT_INDEX(*p)]++] = (int) i;
+    free(pos);
+
+    /* unit clauses */
+    for (i = 0; i < (size_t) c->nclauses; i++) {
+        p = c->lits + c->start[i];
+        if (p[0] == 0 || p[1] != 0)
+            continue;
+        lit = p[0];
+        if (c->vals[abs(lit)] == (lit > 0 ? -1 : 1))
+            return 0;
+        if (c->vals[abs(lit)] == 0)
+            counter_assign(c, lit);
+    }
+    return counter_propagate(c);
+}
+
+/* Count the models of the stream of clauses, and store the count in
+   *res.  Return -1 when out of memory or interrupted. */
+static int count_models(counter_t *c, const int *stream, size_t n,
+                        int max_var, const int *project, int nproject,
+                        bigint_t *res)
+{
+    bigint_t sub = {NULL, 0, 0}, tmp = {NULL, 0, 0};
+    size_t off;
+    int ncomps, nfree, i, err = -1;
+
+    if ((i = counter_init(c, stream, n, max_var, project, nproject)) <= 0) {
+        if (i < 0)
+            c->nomem = 1;
+        return i < 0 ? -1 : big_set(c, res, 0);
+    }
+    /* the root "component" consists of all variables */
+    if (stack_reserve(c, (size_t) c->max_var + 2) < 0)
+        return -1;
+    c->stack[c->nstack++] = c->max_var;
+    for (i = 1; i <= c->max_var; i++)
+        c->stack[c->nstack++] = i;
+    c->stack[c->nstack++] = 0;
+
+    if (decompose(c, 0, &ncomps, &nfree) < 0 ||
+            big_set(c, res, 1) < 0 || big_shl(c, res, nfree) < 0)
+        goto done;
+    off = 2 + (size_t) c->max_var;
+    for (i = 0; i < ncomps && res->n; i++) {
+        if (count_component(c, off, &sub) < 0 ||
+                big_mul(c, res, &sub, &tmp) < 0)
+            goto done;
+        off += 2 + c->stack[off] + c->stack[off + 1 + c->stack[off]];
+    }
+    err = 0;
+
+done:
+    free(sub.d);
+    free(tmp.d);
+    return err;
+}
+
+static PyObject* count(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *clauses, *project_obj = NULL, *timeout = NULL,
+        *deadline_obj = NULL, *ret;
+    int vars = -1, *stream, *project = NULL, nproject = 0, err;
+    Py_ssize_t n;
+    counter_t c;
+    bigint_t res = {NULL, 0, 0};
+    static char* kwlist[] = {"clauses", "vars", "project",
+                             "timeout", "deadline", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iOOO:count", kwlist,
+                                     &clauses, &vars, &project_obj,
+                                     &timeout, &deadline_obj))
+        return NULL;
+
+    memset(&c, 0, sizeof(counter_t));
+    if (get_deadline(timeout, deadline_obj, &c.deadline) < 0)
+        return NULL;
+    if (project_obj && project_obj != Py_None &&
+            (project = get_vars(project_obj, &nproject)) == NULL)
+        return NULL;
+    if ((stream = get_stream(clauses, &n)) == NULL) {
+        PyMem_Free(project);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    err = count_models(&c, stream, (size_t) n, vars < 0 ? 0 : vars,
+                       project, nproject, &res);
+    counter_free(&c);
+    Py_END_ALLOW_THREADS
+
+    PyMem_RawFree(stream);
+    PyMem_Free(project);
+    if (err < 0 && c.nomem)
+        ret = PyErr_NoMemory();
+    else if (err < 0)           /* interrupted */
+        ret = Py_BuildValue("");
+    else
+        ret = big_to_python(&res);
+    free(res.d);
+    return ret;
+}
+
+PyDoc_STRVAR(count_doc,
+"count(clauses [, kwargs]) -> int\n\
+\n\
+Return the number of solutions of the clauses, without enumerating them.\n\
+The count includes the variables up to vars, which are not constrained\n\
+by any clause.  When project (a list of variables) is given, the\n\
+solutions projected onto these variables are counted.  The arguments\n\
+timeout and deadline are those of solve, and None is returned when the\n\
+time limit is reached.\n\
+Please see " PYCOSAT_URL " for more details.");
+
+/****************************** Sampling ****************************/
+
+/* Solutions are sampled near-uniformly as in UniGen: a random hash
+   function, given by m random xor constraints over the projected
+   variables (each variable is in each constraint with probability 1/2),
+   partitions the solutions into 2^m cells.  The solutions of a random cell
+   are enumerated, and when there are between SAMPLE_LO and SAMPLE_HI of
+   them, up to SAMPLE_LO distinct ones are picked at random.  Otherwise m
+   is adjusted, and another cell is tried.
+
+   The cells are enumerated by one picosat instance.  The i-th xor
+   constraint defines a new variable h_i as the parity of its variables,
+   and the cell of the hash value x is selected by assuming h_i = x_i for
+   i < m.  So the same constraints serve SAMPLE_CELLS cells, and m may
+   grow by adding constraints.  The clauses blocking the solutions of a
+   cell hold the negation of a selector variable, which is assumed to be
+   true, and is set to false for good once the cell is done.  Constraints
+   cannot be taken back, and ones with free h_i would spoil picosat's
+   Gaussian elimination of all of them, so the instance is built anew when
+   new constraints are drawn or m shrinks. */
+
+#define SAMPLE_LO  11           /* UniGen2 thresholds for epsilon = 16 */
+#define SAMPLE_HI  64
+#define SAMPLE_TRIES  64        /* cells tried before small cells are ok */
+#define SAMPLE_STEP  4         /* largest change of m while searching */
+#define SAMPLE_CELLS  8         /* cells hashed by the same constraints */
+
+typedef struct {
+    PicoSAT *picosat;
+    const int *stream;          /* the clauses, for rebuilding */
+    size_t n;
+    int max_idx;                /* variables of the solutions */
+    const int *project;         /* variables hashed and blocked */
+    int nproject;
+    uint64_t rng;               /* state of the random number generator */
+    uint64_t bits;              /* random bits, used one at a time */
+    int nbits;
+    int *hash;                  /* the variables h_i of the xor */
+    int nhash;                  /* constraints, and their number */
+    int cells;                  /* cells hashed by them so far */
+    signed char *cell;          /* SAMPLE_HI + 1 solutions of the cell */
+    double deadline;            /* see get_deadline() */
+} sampler_t;
+
+/* return 64 random bits (splitmix64) */
+static uint64_t sample_random(sampler_t *s)
+{
+    uint64_t z = (s->rng += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static int sample_bit(sampler_t *s)
+{
+    int bit;
+
+    if (s->nbits == 0) {
+        s->bits = sample_random(s);
+        s->nbits = 64;
+    }
+    bit = (int) (s->bits & 1);
+    s->bits >>= 1;
+    s->nbits--;
+    return bit;
+}
+
+/* return a random integer in 0, ..., n - 1 */
+static int sample_below(sampler_t *s, int n)
+{
+    return (int) ((sample_random(s) >> 11) % (uint64_t) n);
+}
+
+/* (re)build the picosat instance from the clauses */
+static void sampler_build(sampler_t *s)
+{
+    if (s->picosat)
+        picosat_reset(s->picosat);
+    s->picosat = new_picosat(s->max_idx, 0, 0);
+    picosat_set_seed(s->picosat, (unsigned) sample_random(s));
+    picosat_add_clauses(s->picosat, s->stream, s->n);
+    picosat_set_interrupt(s->picosat, &s->deadline, deadline_passed);
+    s->nhash = s->cells = 0;
+}
+
+/* Enumerate the solutions of a random cell of m xor constraints into
+   s->cell, but no more than SAMPLE_HI + 1 of them.  Return their number,
+   or -1 when interrupted. */
+static int sample_cell(sampler_t *s, int m)
+{
+    PicoSAT *picosat = s->picosat;
+    signed char *vals;
+    int i, k, h, sel, res;
+
+    /* draw new xor constraints, or drop some of them */
+    if (s->cells == SAMPLE_CELLS || s->nhash > m) {
+        sampler_build(s);
+        picosat = s->picosat;
+    }
+    s->cells++;
+    for (; s->nhash < m; s->nhash++) {
+        /* h is the parity of the variables, when the odd number of the
+           literals which are true does not include -h */
+        h = picosat_inc_max_var(picosat);
+        for (k = 0; k < s->nproject; k++)
+            if (sample_bit(s))
+                picosat_add_xor_lit(picosat, s->project[k]);
+        picosat_add_xor_lit(picosat, -h);
+        picosat_add_xor_lit(picosat, 0);
+        s->hash[s->nhash] = h;
+    }
+    for (i = 0; i < m; i++)     /* the hash value */
+        if (!sample_bit(s))
+            s->hash[i] = -s->hash[i];
+    sel = picosat_inc_max_var(picosat);
+
+    for (k = 0; k <= SAMPLE_HI; k++) {
+        for (i = 0; i < m; i++)
+            picosat_assume(picosat, s->hash[i]);
+        picosat_assume(picosat, sel);
+        res = picosat_sat(picosat, -1);
+        if (res == PICOSAT_UNSATISFIABLE)
+            break;
+        if (res != PICOSAT_SATISFIABLE) {
+            k = -1;
+            break;
+        }
+        vals = s->cell + (size_t) k * (s->max_idx + 1);
+        get_values(picosat, vals, s->max_idx);
+        picosat_add(picosat, -sel);
+        for (i = 0; i < s->nproject; i++)
+            picosat_add(picosat, vals[s->project[i]] < 0 ?
+                        s->project[i] : -s->project[i]);
+        picosat_add(picosat, 0);
+    }
+    picosat_add(picosat, -sel);
+    picosat_add(picosat, 0);
+    return k;
+}
+
+/* Store up to n samples in out (each of which takes max_idx + 1 bytes),
+   and return their number, which is less than n when the clauses are
+   unsatisfiable or the deadline has passed.  Does not need the GIL. */
+static int sample_models(sampler_t *s, int n, signed char *out)
+{
+    size_t width = (size_t) s->max_idx + 1;
+    int idx[SAMPLE_HI + 1], got = 0, m = 0, step = 1, fails = 0;
+    int lo_m = -1, hi_m = -1;   /* cells too large / too small */
+    int i, j, k;
+
+    sampler_build(s);
+    while (got < n) {
+        if ((k = sample_cell(s, m)) < 0)
+            break;
+        if (m == 0 && k <= SAMPLE_HI) {
+            /* all (projected) solutions are known, pick uniformly */
+            for (; got < n && k; got++)
+                memcpy(out + got * width,
+                       s->cell + sample_below(s, k) * width, width);
+            break;
+        }
+        if (k > SAMPLE_HI) {    /* more xor constraints */
+            lo_m = m;
+            if (hi_m <= lo_m)
+                hi_m = -1;
+            if (hi_m < 0) {
+                m += step;
+                if (step < SAMPLE_STEP)
+                    step *= 2;
+            }
+            else
+                m = (lo_m + hi_m + 1) / 2;
+            if (m > s->nproject)
+                m = s->nproject;
+            fails++;
+            continue;
+        }
+        if (k == 0 || (k < SAMPLE_LO && fails < SAMPLE_TRIES)) {
+            hi_m = m;           /* fewer xor constraints */
+            if (lo_m >= hi_m)
+                lo_m = -1;
+            if (lo_m < 0) {
+                m -= step;
+                if (step < SAMPLE_STEP)
+                    step *= 2;
+                if (m < 0)
+                    m = 0;
+            }
+            else
+                m = (lo_m + hi_m + 1) / 2;
+            fails++;
+            continue;
+        }
+        /* pick distinct solutions of the cell at random */
+        for (i = 0; i < k; i++)
+            idx[i] = i;
+        for (i = 0; i < SAMPLE_LO && i < k && got < n; i++, got++) {
+            j = i + sample_below(s, k - i);
+            memcpy(out + got * width, s->cell + idx[j] * width, width);
+            idx[j] = idx[i];
+        }
+        lo_m = hi_m = -1;
+        step = 1;
+        fails = 0;
+    }
+    picosat_reset(s->picosat);
+    return got;
+}
+
+static PyObject* sample(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *clauses, *project_obj = NULL, *seed_obj = NULL,
+        *timeout = NULL, *deadline_obj = NULL, *res = NULL, *sol;
+    int vars = -1, n, *stream, *project = NULL, nproject = 0, output;
+    int i, got = 0;
+    Py_ssize_t len;
+    signed char *out = NULL;
+    size_t width;
+    const char *output_name = NULL;
+    sampler_t s;
+    static char* kwlist[] = {"clauses", "n", "vars", "project", "seed",
+                             "output", "timeout", "deadline", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oi|iOOzOO:sample", kwlist,
+                                     &clauses, &n, &vars, &project_obj,
+                                     &seed_obj, &output_name,
+                                     &timeout, &deadline_obj))
+        return NULL;
+
+    if (n < 0) {
+        PyErr_SetString(PyExc_ValueError, "n must not be negative");
+        return NULL;
+    }
+    if ((output = get_output(output_name)) < 0)
+        return NULL;
+
+    memset(&s, 0, sizeof(sampler_t));
+    if (get_deadline(timeout, deadline_obj, &s.deadline) < 0)
+        return NULL;
+    if (seed_obj == NULL || seed_obj == Py_None)
+        s.rng = (uint64_t) (clock_monotonic() * 1e9);
+    else {
+        s.rng = (uint64_t) PyLong_AsUnsignedLongLongMask(seed_obj);
+        if (PyErr_Occurred())
+            return NULL;
+    }
+    if (project_obj && project_obj != Py_None &&
+            (project = get_vars(project_obj, &nproject)) == NULL)
+        return NULL;
+    if ((stream = get_stream(clauses, &len)) == NULL)
+        goto done;
+
+    s.max_idx = vars < 0 ? 0 : vars;
+    for (i = 0; i < len; i++)
+        if (abs(stream[i]) > s.max_idx)
+            s.max_idx = abs(stream[i]);
+    if (nproject && project[nproject - 1] > s.max_idx)
+        s.max_idx = project[nproject - 1];
+    if (project == NULL) {      /* project onto all variables */
+        if ((project = PyMem_Malloc((s.max_idx + 1) * sizeof(int))) == NULL)
+            goto nomem;
+        for (nproject = 0; nproject < s.max_idx; nproject++)
+            project[nproject] = nproject + 1;
+    }
+    s.stream = stream;
+    s.n = (size_t) len;
+    s.project = project;
+    s.nproject = nproject;
+
+    width = (size_t) s.max_idx + 1;
+    if (width > (size_t) PY_SSIZE_T_MAX / (n > SAMPLE_HI ? n : SAMPLE_HI + 1))
+        goto nomem;
+    s.hash = PyMem_Malloc((nproject + 1) * sizeof(int));
+    s.cell = PyMem_Malloc((SAMPLE_HI + 1) * width);
+    out = PyMem_Malloc(n * width + 1);
+    if (s.hash == NULL || s.cell == NULL || out == NULL)
+        goto nomem;
+
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    got = sample_models(&s, n, out);
+    Py_END_ALLOW_THREADS
+
+    if ((res = PyList_New((Py_ssize_t) got)) == NULL)
+        goto done;
+    for (i = 0; i < got; i++) {
+        if ((sol = new_solution(out + i * width, s.max_idx, output)) == NULL) {
+            Py_CLEAR(res);
+            goto done;
+        }
+        PyList_SET_ITEM(res, i, sol);
+    }
+    goto done;
+
+nomem:
+    PyErr_NoMemory();
+done:
+    PyMem_RawFree(stream);
+    PyMem_Free(project);
+    PyMem_Free(s.hash);
+    PyMem_Free(s.cell);
+    PyMem_Free(out);
+    return res;
+}
+
+PyDoc_STRVAR(sample_doc,
+"sample(clauses, n [, kwargs]) -> list\n\
+\n\
+Return a list of n solutions of the clauses, sampled (near) uniformly\n\
+at random by hashing the solutions with random xor constraints.  When\n\
+project (a list of variables) is given, the solutions projected onto\n\
+these variables are sampled.  The random choices are made reproducible\n\
+by an integer seed.  The arguments vars, output, timeout and deadline\n\
+are those of solve.  Fewer than n solutions are returned when the\n\
+clauses are unsatisfiable, or when the time limit is reached.\n\
+Please see " PYCOSAT_URL " for more details.");
+
+/**************************** Optimization ***************************/
+
+/* A totalizer counts its inputs in unary: its output out[k] is implied by
+   k + 1 or more true inputs (the other direction is not encoded, as only
+   upper bounds are asserted, by assuming -out[k]), or for lower bounds
+   the other way round.  It is a binary tree, the leaves of which are the
+   inputs, and the outputs of each inner node are built lazily, only as
+   far as they are needed. */
+typedef struct totalizer {
+    struct totalizer *left, *right;  /* both NULL for an input */
+    int n;                      /* number of inputs below */
+    int *out;                   /* outputs built so far */
+    int nout;
+} totalizer_t;
+
+static void tot_free(totalizer_t *t)
+{
+    if (t == NULL)
+        return;
+    tot_free(t->left);
+    tot_free(t->right);
+    free(t->out);
+    free(t);
+}
+
+/* return a new totalizer of the n literals at lits, or NULL */
+static totalizer_t* tot_new(const int *lits, int n)
+{
+    totalizer_t *t;
+
+    assert(n > 0);
+    if ((t = calloc(1, sizeof(totalizer_t))) == NULL)
+        return NULL;
+    t->n = n;
+    if (n == 1) {
+        if ((t->out = malloc(sizeof(int))) == NULL) {
+            free(t);
+            return NULL;
+        }
+        t->out[0] = lits[0];
+        t->nout = 1;
+        return t;
+    }
+    if ((t->left = tot_new(lits, n / 2)) == NULL ||
+            (t->right = tot_new(lits + n / 2, n - n / 2)) == NULL) {
+        tot_free(t);
+        return NULL;
+    }
+    return t;
+}
+
+#define CARD_UPPER  1           /* directions of counting encodings */
+#define CARD_LOWER  2
+
+/* Build the outputs of t up to out[k - 1] (or all of them), by adding
+   the clauses -left[i - 1] | -right[j - 1] | out[i + j - 1] for the new
+   sums i + j, and for lower bounds -out[i + j] | left[i] | right[j]
+   (where left[a] is false for a left node of a inputs, and likewise for
+   right).  Return -1 when out of memory. */
+static int tot_grow(PicoSAT *picosat, totalizer_t *t, int k, int dirs)
+{
+    int *out, old = t->nout, i, j;
+
+    if (k > t->n)
+        k = t->n;
+    if (k <= old)
+        return 0;
+    if (tot_grow(picosat, t->left, k, dirs) < 0 ||
+            tot_grow(picosat, t->right, k, dirs) < 0)
+        return -1;
+    if ((out = realloc(t->out, k * sizeof(int))) == NULL)
+        return -1;
+    t->out = out;
+    for (i = old; i < k; i++)
+        out[i] = picosat_inc_max_var(picosat);
+
+    if (dirs & CARD_LOWER)
+        for (i = 0; i <= t->left->n && i < k; i++)
+            for (j = 0; j <= t->right->n && i + j < k; j++) {
+                if (i + j < old)
+                    continue;
+                picosat_add(picosat, -out[i + j]);
+                if (i < t->left->n)
+                    picosat_add(picosat, t->left->out[i]);
+                if (j < t->right->n)
+                    picosat_add(picosat, t->right->out[j]);
+                picosat_add(picosat, 0);
+            }
+    if (dirs & CARD_UPPER)
+        for (i = 0; i <= t->left->nout && i <= k; i++)
+            for (j = 0; j <= t->right->nout && i + j <= k; j++) {
+                if (i + j <= old)
+                    continue;
+                if (i)
+                    picosat_add(picosat, -t->left->out[i - 1]);
+                if (j)
+                    picosat_add(picosat, -t->right->out[j - 1]);
+                picosat_add(picosat, out[i + j - 1]);
+                picosat_add(picosat, 0);
+            }
+    t->nout = k;
+    return 0;
+}
+
+static int tot_extend(PicoSAT *picosat, totalizer_t *t, int k)
+{
+    return tot_grow(picosat, t, k, CARD_UPPER);
+}
+
+/* The objective is minimized by the core-guided OLL algorithm, with
+   stratification.  Each soft literal is assumed to be true, and costs its
+   weight when false.  When the assumptions fail, the failed ones form a
+   core, at least one of which is false in every solution: the lower bound
+   is raised by the smallest weight w of the core, the weights of its soft
+   literals are lowered by w, and a new soft literal -out[1] of weight w,
+   that is at most one of them is false, is added on top of a totalizer of
+   their negations.  When such a soft literal -out[k] is part of a core,
+   the next one -out[k + 1] is added.  Only soft literals of weight at
+   least a threshold are assumed, which is lowered when the assumptions
+   are satisfied.  Each solution found gives an upper bound, and once
+   both bounds meet, the best solution found is optimal.  Several
+   objectives are minimized lexicographically on the same instance: once
+   one is optimal, all its soft literals of positive weight are added as
+   unit clauses, which leaves exactly its optimal solutions, and the
+   totalizers (with what picosat learned) are kept for the next one.
+   The k best solutions are found one after the other, by blocking each
+   one and searching again: the cores, the totalizers and the lower bound
+   remain valid when clauses are added, so each search picks up where the
+   last one stopped.  Then, no soft literals are hardened, as solutions
+   worse than the best one found so far are still needed. */
+
+/* an objective, as literals which cost their weight when false */
+typedef struct {
+    int *terms;
+    long long *weights;
+    int nterms;
+    long long offset;           /* cost when all terms are true */
+} objective_t;
+
+typedef struct {
+    int lit;                    /* assumed to be true */
+    long long weight;           /* cost when false, 0 once dropped */
+    totalizer_t *tot;           /* when lit is -tot->out[k] */
+    int k;
+} soft_t;
+
+typedef struct {
+    PicoSAT *picosat;
+    int max_idx;                /* variables of the solutions */
+    objective_t *objs;          /* the objectives, in order */
+    int nobjs;
+    long long *costs;           /* their optimal costs */
+    const objective_t *obj;     /* the one being minimized */
+    soft_t *softs;
+    int nsofts, ssofts;
+    totalizer_t **tots;         /* all totalizers, to be freed */
+    int ntots, stots;
+    int *index;                 /* soft index + 1 of each variable */
+    int sindex;
+    int *core;
+    signed char *best;          /* values of the best solution */
+    long long lb, ub;           /* lower bound, cost of best */
+    int found;                  /* best holds a solution */
+    int k;                      /* solutions wanted, 0 for the optimum */
+    int *project;               /* sorted variables to project onto, */
+    int nproject;               /* or NULL */
+    signed char *sols;          /* values of the k best solutions, */
+    long long *solcosts;        /* and their costs */
+    int nsols, ssols;
+    int nomem;
+    double deadline;            /* see get_deadline() */
+} optimizer_t;
+
+/* add a soft literal, return -1 when out of memory */
+static int opt_add_soft(optimizer_t *o, int lit, long long weight,
+                        totalizer_t *tot, int k)
+{
+    soft_t *softs;
+    int *index, *core, var = abs(lit), n;
+
+    if (o->nsofts == o->ssofts) {
+        n = 2 * o->ssofts + 16;
+        if ((softs = realloc(o->softs, n * sizeof(soft_t))) == NULL)
+            return -1;
+        o->softs = softs;
+        if ((core = realloc(o->core, n * sizeof(int))) == NULL)
+            return -1;
+        o->core = core;
+        o->ssofts = n;
+    }
+    if (var >= o->sindex) {
+        n = 2 * var + 16;
+        if ((index = realloc(o->index, n * sizeof(int))) == NULL)
+            return -1;
+        memset(index + o->sindex, 0, (n - o->sindex) * sizeof(int));
+        o->index = index;
+        o->sindex = n;
+    }
+    o->softs[o->nsofts].lit = lit;
+    o->softs[o->nsofts].weight = weight;
+    o->softs[o->nsofts].tot = tot;
+    o->softs[o->nsofts].k = k;
+    o->index[var] = ++o->nsofts;
+    return 0;
+}
+
+/* add the soft literal -tot->out[k] of the given weight, if there is
+   such an output, or add the weight to it, if it is a soft literal
+   already */
+static int opt_add_output(optimizer_t *o, totalizer_t *tot, int k,
+                          long long weight)
+{
+    int var;
+
+    if (k >= tot->n)
+        return 0;
+    if (k < tot->nout && (var = tot->out[k]) < o->sindex &&
+            o->index[var]) {
+        o->softs[o->index[var] - 1].weight += weight;
+        return 0;
+    }
+    if (tot_extend(o->picosat, tot, k + 1) < 0)
+        return -1;
+    return opt_add_soft(o, -tot->out[k], weight, tot, k);
+}
+
+/* the cost of the solution found by picosat */
+static long long opt_cost(optimizer_t *o)
+{
+    long long cost = o->obj->offset;
+    int i;
+
+    for (i = 0; i < o->obj->nterms; i++)
+        if (picosat_deref(o->picosat, o->obj->terms[i]) < 0)
+            cost += o->obj->weights[i];
+    return cost;
+}
+
+/* Process the solution found by picosat: keep it when it is the best one,
+   and harden the soft literals which no better solution can falsify. */
+static void opt_solution(optimizer_t *o)
+{
+    long long cost = opt_cost(o);
+    soft_t *s;
+    int i;
+
+    if (o->found && cost >= o->ub)
+        return;
+    o->ub = cost;
+    o->found = 1;
+    get_values(o->picosat, o->best, o->max_idx);
+    if (o->k)
+        return;
+    for (i = 0; i < o->nsofts; i++) {
+        s = o->softs + i;
+        if (s->weight && o->lb + s->weight > o->ub) {
+            picosat_add(o->picosat, s->lit);
+            picosat_add(o->picosat, 0);
+            s->weight = 0;
+        }
+    }
+}
+
+/* Process the core of the failed assumptions, return -1 when out of
+   memory. */
+static int opt_core(optimizer_t *o, const int *failed)
+{
+    totalizer_t *tot, **tots;
+    soft_t *s;
+    long long w = 0;
+    int i, n;
+
+    for (n = 0; failed[n]; n++) {
+        o->core[n] = o->index[abs(failed[n])] - 1;
+        s = o->softs + o->core[n];
+        assert(s->lit == failed[n] && s->weight > 0);
+        if (w == 0 || s->weight < w)
+            w = s->weight;
+    }
+    assert(n > 0);
+    o->lb += w;
+    for (i = 0; i < n; i++) {
+        s = o->softs + o->core[i];
+        s->weight -= w;
+        if (s->tot && opt_add_output(o, s->tot, s->k + 1, w) < 0)
+            return -1;
+        /* softs may have moved */
+        s = o->softs + o->core[i];
+        o->core[i] = -s->lit;
+        if (n == 1) {
+            picosat_add(o->picosat, -s->lit);
+            picosat_add(o->picosat, 0);
+        }
+    }
+    if (n == 1)
+        return 0;
+
+    if (o->ntots == o->stots) {
+        i = 2 * o->stots + 16;
+        if ((tots = realloc(o->tots, i * sizeof(totalizer_t *))) == NULL)
+            return -1;
+        o->tots = tots;
+        o->stots = i;
+    }
+    if ((tot = tot_new(o->core, n)) == NULL)
+        return -1;
+    o->tots[o->ntots++] = tot;
+    return opt_add_output(o, tot, 1, w);
+}
+
+/* start minimizing the objective obj, return -1 when out of memory */
+static int opt_start(optimizer_t *o, const objective_t *obj)
+{
+    int i;
+
+    o->obj = obj;
+    o->nsofts = 0;
+    if (o->index)
+        memset(o->index, 0, o->sindex * sizeof(int));
+    for (i = 0; i < obj->nterms; i++)
+        if (opt_add_soft(o, obj->terms[i], obj->weights[i], NULL, 0) < 0)
+            return -1;
+    o->lb = obj->offset;
+    return 0;
+}
+
+/* Search for a solution of least cost, and return the last picosat
+   result, which is PICOSAT_SATISFIABLE when o->best is optimal. */
+static int opt_search(optimizer_t *o)
+{
+    long long strat = 0, next;
+    const int *failed;
+    soft_t *s;
+    int i, res;
+
+    o->found = 0;
+    for (i = 0; i < o->nsofts; i++)
+        if (o->softs[i].weight > strat)
+            strat = o->softs[i].weight;
+
+    for (;;) {
+        for (i = 0; i < o->nsofts; i++)
+            if (o->softs[i].weight && o->softs[i].weight >= strat)
+                picosat_assume(o->picosat, o->softs[i].lit);
+        res = picosat_sat(o->picosat, -1);
+
+        if (res == PICOSAT_SATISFIABLE) {
+            opt_solution(o);
+            if (o->ub == o->lb)
+                break;
+            /* lower the threshold to the next smaller weight */
+            next = 0;
+            for (i = 0; i < o->nsofts; i++) {
+                s = o->softs + i;
+                if (s->weight && s->weight < strat && s->weight > next)
+                    next = s->weight;
+            }
+            if (next == 0)      /* all soft literals are satisfied */
+                break;
+            strat = next;
+        }
+        else if (res == PICOSAT_UNSATISFIABLE) {
+            failed = picosat_failed_assumptions(o->picosat);
+            if (*failed == 0)   /* the clauses are unsatisfiable */
+                return res;
+            if (opt_core(o, failed) < 0) {
+                o->nomem = 1;
+                return PICOSAT_UNKNOWN;
+            }
+            if (o->found && o->lb >= o->ub)
+                break;
+        }
+        else
+            return res;
+    }
+    return PICOSAT_SATISFIABLE;
+}
+
+/* Minimize the objective obj, and return the last picosat result, which
+   is PICOSAT_SATISFIABLE when o->best is optimal.  The optimum is then
+   frozen by hardening all soft literals of positive weight, as exactly
+   the optimal solutions satisfy all of them. */
+static int opt_minimize(optimizer_t *o, const objective_t *obj)
+{
+    int i, res;
+
+    if (opt_start(o, obj) < 0) {
+        o->nomem = 1;
+        return PICOSAT_UNKNOWN;
+    }
+    if ((res = opt_search(o)) != PICOSAT_SATISFIABLE)
+        return res;
+
+    for (i = 0; i < o->nsofts; i++)
+        if (o->softs[i].weight) {
+            picosat_add(o->picosat, o->softs[i].lit);
+            picosat_add(o->picosat, 0);
+        }
+    return PICOSAT_SATISFIABLE;
+}
+
+/* Find the o->k best solutions of the first objective (projected, when
+   o->project is given), in order, and store them in o->sols.  Each one is
+   blocked once found, such that the next search finds the best one of
+   those left.  Return the last picosat result. */
+static int opt_best(optimizer_t *o)
+{
+    size_t width = (size_t) o->max_idx + 1;
+    signed char *vals;
+    long long *costs;
+    int i, n, res;
+
+    if (opt_start(o, o->objs) < 0) {
+        o->nomem = 1;
+        return PICOSAT_UNKNOWN;
+    }
+    while (o->nsols < o->k) {
+        if ((res = opt_search(o)) != PICOSAT_SATISFIABLE)
+            return res;
+        if (o->nsols == o->ssols) {
+            n = o->ssols < o->k / 2 ? 2 * o->ssols + 4 : o->k;
+            if ((vals = realloc(o->sols, n * width)) == NULL)
+                goto nomem;
+            o->sols = vals;
+            if ((costs = realloc(o->solcosts,
+                                 n * sizeof(long long))) == NULL)
+                goto nomem;
+            o->solcosts = costs;
+            o->ssols = n;
+        }
+        vals = o->sols + o->nsols * width;
+        memcpy(vals, o->best, width);
+        if (o->project)
+            project_values(vals, o->max_idx, o->project, o->nproject);
+        o->solcosts[o->nsols++] = o->ub;
+        /* block the solution, such that it is not found again */
+        for (i = 1; i <= o->max_idx; i++)
+            if (vals[i])
+                picosat_add(o->picosat, vals[i] < 0 ? i : -i);
+        picosat_add(o->picosat, 0);
+    }
+    return PICOSAT_SATISFIABLE;
+
+nomem:
+    o->nomem = 1;
+    return PICOSAT_UNKNOWN;
+}
+
+/* Minimize the objectives one after the other, without the GIL, and
+   return PICOSAT_SATISFIABLE when o->best is optimal. */
+static int optimize(optimizer_t *o)
+{
+    int i, res;
+
+    if (o->nobjs == 0) {
+        res = picosat_sat(o->picosat, -1);
+        if (res == PICOSAT_SATISFIABLE)
+            get_values(o->picosat, o->best, o->max_idx);
+        return res;
+    }
+    for (i = 0; i < o->nobjs; i++) {
+        if ((res = opt_minimize(o, o->objs + i)) != PICOSAT_SATISFIABLE)
+            return res;
+        o->costs[i] = o->ub;
+    }
+    return res;
+}
+
+static void optimizer_free(optimizer_t *o)
+{
+    int i;
+
+    for (i = 0; i < o->ntots; i++)
+        tot_free(o->tots[i]);
+    free(o->tots);
+    free(o->softs);
+    free(o->index);
+    free(o->core);
+    for (i = 0; i < o->nobjs; i++) {
+        free(o->objs[i].terms);
+        free(o->objs[i].weights);
+    }
+    free(o->objs);
+    free(o->costs);
+    free(o->best);
+    free(o->sols);
+    free(o->solcosts);
+    if (o->picosat)
+        picosat_reset(o->picosat);
+}
+
+/* Read the objective, an iterable of (weight, literal) pairs, into obj:
+   the cost of a literal l of weight w is that of -l of weight -w plus w,
+   and the weights of the same variable are added up, such that each
+   variable occurs in at most one term, as a literal of positive weight
+   which costs its weight when false.  The largest variable is stored in
+   *max_idx, if that is larger. */
+static int opt_objective(PyObject *objective, objective_t *obj,
+                         int *max_idx)
+{
+    PyObject *iterator, *item, *fast;
+    long long w, *cost = NULL, *tmp;
+    int lit, var, size = 0, n;
+
+    if ((iterator = PyObject_GetIter(objective)) == NULL)
+        return -1;
+    while ((item = PyIter_Next(iterator)) != NULL) {
+        fast = PySequence_Fast(item, "objective term must be a sequence");
+        Py_DECREF(item);
+        if (fast == NULL)
+            goto error;
+        if (PySequence_Fast_GET_SIZE(fast) != 2) {
+            Py_DECREF(fast);
+            PyErr_SetString(PyExc_ValueError,
+                            "objective term must be (weight, literal)");
+            goto error;
+        }
+        w = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(fast, 0));
+        if ((w == -1 && PyErr_Occurred()) ||
+                get_lit(PySequence_Fast_GET_ITEM(fast, 1), &lit) < 0) {
+            Py_DECREF(fast);
+            goto error;
+        }
+        Py_DECREF(fast);
+        var = abs(lit);
+        if (var >= size) {
+            n = 2 * var + 16;
+            if ((tmp = realloc(cost, n * sizeof(long long))) == NULL) {
+                PyErr_NoMemory();
+                goto error;
+            }
+            memset(tmp + size, 0, (n - size) * sizeof(long long));
+            cost = tmp;
+            size = n;
+        }
+        /* cost[var] is the cost of var being true, minus that of false */
+        if (lit > 0)
+            cost[var] += w;
+        else {
+            cost[var] -= w;
+            obj->offset += w;
+        }
+        if (var > *max_idx)
+            *max_idx = var;
+    }
+    if (PyErr_Occurred())
+        goto error;
+    Py_DECREF(iterator);
+
+    for (n = 0, var = 1; var < size; var++)
+        n += cost[var] != 0;
+    obj->terms = malloc((n + 1) * sizeof(int));
+    obj->weights = malloc((n + 1) * sizeof(long long));
+    if (obj->terms == NULL || obj->weights == NULL) {
+        free(cost);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (var = 1; var < size; var++) {
+        if (cost[var] > 0) {
+            obj->terms[obj->nterms] = -var;
+            obj->weights[obj->nterms++] = cost[var];
+        }
+        else if (cost[var] < 0) {
+            obj->offset += cost[var];
+            obj->terms[obj->nterms] = var;
+            obj->weights[obj->nterms++] = -cost[var];
+        }
+    }
+    free(cost);
+    return 0;
+
+error:
+    Py_DECREF(iterator);
+    free(cost);
+    return -1;
+}
+
+/* Return the k best solutions in o->sols as a list of (solution, cost)
+   pairs. */
+static PyObject* opt_solutions(optimizer_t *o, int output)
+{
+    PyObject *list, *sol, *item;
+    int i;
+
+    if ((list = PyList_New(o->nsols)) == NULL)
+        return NULL;
+    for (i = 0; i < o->nsols; i++) {
+        sol = new_solution(o->sols + i * ((size_t) o->max_idx + 1),
+                           o->max_idx, output);
+        if (sol == NULL ||
+                (item = Py_BuildValue("(NL)", sol, o->solcosts[i])) == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+}
+
+/* Minimize the objectives (a sequence of them) in order, and return the
+   optimal solution together with the list of their costs, or with the
+   cost of the first objective only, unless lex.  When k > 0, return the
+   list of the k best solutions (of the first objective) instead.  The
+   solutions are projected onto project_obj, unless it is NULL. */
+static PyObject* optimize_clauses(PyObject *clauses, PyObject *objectives,
+                                  int lex, int k, PyObject *project_obj,
+                                  int vars, int verbose, int output,
+                                  double deadline)
+{
+    PyObject *seq, *sol, *costs, *ret = NULL;
+    int res, i, max_idx = 0;
+    optimizer_t o;
+
+    if ((seq = PySequence_Fast(objectives,
+                               "sequence of objectives expected")) == NULL)
+        return NULL;
+    memset(&o, 0, sizeof(optimizer_t));
+    o.deadline = deadline;
+    o.k = k;
+    if (project_obj && project_obj != Py_None &&
+            (o.project = get_vars(project_obj, &o.nproject)) == NULL)
+        goto done;
+    if (o.nproject && o.project[o.nproject - 1] > max_idx)
+        max_idx = o.project[o.nproject - 1];
+    i = (int) PySequence_Fast_GET_SIZE(seq);
+    o.objs = calloc(i + 1, sizeof(objective_t));
+    o.costs = malloc((i + 1) * sizeof(long long));
+    if (o.objs == NULL || o.costs == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (; o.nobjs < i; o.nobjs++)
+        if (opt_objective(PySequence_Fast_GET_ITEM(seq, o.nobjs),
+                          o.objs + o.nobjs, &max_idx) < 0)
+            goto done;
+
+    o.picosat = new_picosat(vars, verbose, 0);
+    if (load_picosat(o.picosat, add_clauses, clauses, verbose) == NULL) {
+        o.picosat = NULL;
+        goto done;
+    }
+    if (max_idx > picosat_variables(o.picosat))
+        picosat_adjust(o.picosat, max_idx);
+    o.max_idx = picosat_variables(o.picosat);
+    picosat_set_interrupt(o.picosat, &o.deadline, deadline_passed);
+    if ((o.best = malloc(o.max_idx + 1)) == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    res = k ? opt_best(&o) : optimize(&o);
+    Py_END_ALLOW_THREADS
+
+    if (o.nomem)
+        PyErr_NoMemory();
+    else if (k)                 /* fewer when no more solutions are left */
+        ret = opt_solutions(&o, output);
+    else if (res != PICOSAT_SATISFIABLE)
+        ret = get_result(o.picosat, res, output);
+    else {
+        if (o.project)
+            project_values(o.best, o.max_idx, o.project, o.nproject);
+        if ((sol = new_solution(o.best, o.max_idx, output)) == NULL)
+            goto done;
+        if (!lex)
+            ret = Py_BuildValue("(NL)", sol, o.costs[0]);
+        else if ((costs = PyList_New(o.nobjs)) == NULL)
+            Py_DECREF(sol);
+        else {
+            for (i = 0; i < o.nobjs; i++)
+                PyList_SET_ITEM(costs, i, PyLong_FromLongLong(o.costs[i]));
+            ret = Py_BuildValue("(NN)", sol, costs);
+        }
+    }
+
+done:
+    Py_DECREF(seq);
+    PyMem_Free(o.project);
+    optimizer_free(&o);
+    return ret;
+}
+
+static PyObject* minimize(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *clauses, *objective, *timeout = NULL, *deadline_obj = NULL;
+    PyObject *k_obj = NULL, *project_obj = NULL, *objectives, *ret;
+    int vars = -1, verbose = 0, output, k = 0;
+    long kl;
+    const char *output_name = NULL;
+    double deadline;
+    static char* kwlist[] = {"clauses", "objective", "vars", "verbose",
+                             "output", "timeout", "deadline", "k",
+                             "project", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|iizOOOO:minimize",
+                                     kwlist, &clauses, &objective,
+                                     &vars, &verbose, &output_name,
+                                     &timeout, &deadline_obj, &k_obj,
+                                     &project_obj))
+        return NULL;
+
+    if ((output = get_output(output_name)) < 0 ||
+            get_deadline(timeout, deadline_obj, &deadline) < 0)
+        return NULL;
+    if (k_obj && k_obj != Py_None) {
+        kl = PyLong_AsLong(k_obj);
+        if (kl == -1 && PyErr_Occurred())
+            return NULL;
+        if (kl <= 0) {
+            PyErr_SetString(PyExc_ValueError, "k must be positive");
+            return NULL;
+        }
+        k = kl > INT_MAX ? INT_MAX : (int) kl;
+    }
+
+    if ((objectives = PyTuple_Pack(1, objective)) == NULL)
+        return NULL;
+    ret = optimize_clauses(clauses, objectives, 0, k, project_obj,
+                           vars, verbose, output, deadline);
+    Py_DECREF(objectives);
+    return ret;
+}
+
+PyDoc_STRVAR(minimize_doc,
+"minimize(clauses, objective [, kwargs]) -> (list, int)\n\
+\n\
+Return a solution of the clauses which minimizes the objective, an\n\
+iterable of (weight, literal) pairs, where the cost of a solution is\n\
+the sum of the weights of the literals it makes true, together with\n\
+its cost.  The search is core-guided (OLL with stratification), on a\n\
+single picosat instance.  When the clauses are unsatisfiable, or the\n\
+time limit is reached, \"UNSAT\" or \"UNKNOWN\" is returned (like solve\n\
+does).  When k is given, a list of the k best distinct solutions is\n\
+returned instead, as (solution, cost) pairs in order of their costs,\n\
+which is shorter when there are fewer solutions, or when the time limit\n\
+is reached.  When project (a list of variables) is given, the solutions\n\
+are projected onto these variables.  The arguments vars, verbose,\n\
+output, timeout and deadline are those of solve.\n\
+Please see " PYCOSAT_URL " for more details.");
+
+static PyObject* minimize_lex(PyObject *self, PyObject *args,
+                              PyObject *kwds)
+{
+    PyObject *clauses, *objectives, *timeout = NULL, *deadline_obj = NULL;
+    int vars = -1, verbose = 0, output;
+    const char *output_name = NULL;
+    double deadline;
+    static char* kwlist[] = {"clauses", "objectives", "vars", "verbose",
+                             "output", "timeout", "deadline", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|iizOO:minimize_lex",
+                                     kwlist, &clauses, &objectives,
+                                     &vars, &verbose, &output_name,
+                                     &timeout, &deadline_obj))
+        return NULL;
+
+    if ((output = get_output(output_name)) < 0 ||
+            get_deadline(timeout, deadline_obj, &deadline) < 0)
+        return NULL;
+
+    return optimize_clauses(clauses, objectives, 1, 0, NULL,
+                            vars, verbose, output, deadline);
+}
+
+PyDoc_STRVAR(minimize_lex_doc,
+"minimize_lex(clauses, objectives [, kwargs]) -> (list, list)\n\
+\n\
+Return a solution of the clauses which minimizes the objectives (a\n\
+sequence of objectives as for minimize) lexicographically, that is the\n\
+first one, then the second one among the solutions which minimize the\n\
+first one, and so on, together with the list of their costs.  Each\n\
+optimum is frozen as hard clauses before the next objective is\n\
+minimized, on the same picosat instance.  When the clauses are\n\
+unsatisfiable, or the time limit is reached, \"UNSAT\" or \"UNKNOWN\" is\n\
+returned.  The arguments vars, verbose, output, timeout and deadline are\n\
+those of solve.\n\
+Please see " PYCOSAT_URL " for more details.");
+
+/*********************** Cardinality constraints ***********************/
+
+/* Constraints on the number of true literals are added to picosat, which
+   propagates them natively: at most k of the literals are true, and at
+   least k of them when at most n - k of their negations are.
+   Pseudo-Boolean constraints on a weighted sum of literals are encoded
+   into clauses right here, which add auxiliary variables to picosat.  One
+   whose coefficients are all equal is a cardinality constraint, any other
+   one is encoded as a reduced ordered BDD, built by the interval method of
+   Abio et al., or by adders when the BDD would be too large.  Only the
+   directions needed for an upper bound are encoded, lower bounds being
+   upper bounds of the negated literals. */
+
+static void add_clause3(PicoSAT *picosat, int a, int b, int c)
+{
+    picosat_add(picosat, a);
+    if (b) {
+        picosat_add(picosat, b);
+        if (c)
+            picosat_add(picosat, c);
+    }
+    picosat_add(picosat, 0);
+}
+
+/* Add the constraint that at most (dirs & CARD_UPPER) and/or at least
+   (dirs & CARD_LOWER) k of the n literals x are true.  Return -1 when out
+   of memory. */
+static int card_constraint(PicoSAT *picosat, const int *x, int n, int k,
+                           int dirs)
+{
+    int *y, i;
+
+    if (dirs & CARD_UPPER)
+        picosat_add_atmost(picosat, x, n, k);
+    if ((dirs & CARD_LOWER) && k > 0) {
+        if ((y = malloc((n + 1) * sizeof(int))) == NULL)
+            return -1;
+        for (i = 0; i < n; i++)
+            y[i] = -x[i];
+        picosat_add_atmost(picosat, y, n, n - k);
+        free(y);
+    }
+    return 0;
+}
+
+/* a term coef * lit of a pseudo-Boolean constraint */
+typedef struct {
+    long long coef;
+    int lit;
+} pbterm_t;
+
+static int pb_cmp_var(const void *p, const void *q)
+{
+    return abs(((const pbterm_t *) p)->lit) - abs(((const pbterm_t *) q)->lit);
+}
+
+static int pb_cmp_coef(const void *p, const void *q)
+{
+    long long a = ((const pbterm_t *) p)->coef;
+    long long b = ((const pbterm_t *) q)->coef;
+
+    return a < b ? 1 : (a > b ? -1 : 0);
+}
+
+/* The node of level i of the BDD for k is the constraint that the terms
+   i, i + 1, ... sum up to at most k, which is the same node for all k of
+   an interval [lo, hi].  The intervals of the nodes built so far are kept
+   for each level, sorted by lo.  Once the BDD is complete, each node gets
+   a literal, which implies its constraint: -node | -lit[i] | node1, and
+   -node | node0, where node1 (node0) is the node of level i + 1 for the
+   term being true (false).  BDDs of more than BDD_MAX_NODES intervals
+   (at least as many as nodes) are given up. */
+#define BDD_MAX_NODES  (1 << 18)
+#define BDD_TRUE   (-1)
+#define BDD_FALSE  (-2)
+
+typedef struct {
+    long long lo, hi;
+    int node;
+} interval_t;
+
+typedef struct {
+    interval_t *iv;
+    int n, size;
+} bdd_level_t;
+
+typedef struct {
+    int level, node0, node1;
+} bdd_node_t;
+
+typedef struct {
+    const pbterm_t *terms;
+    long long *sum;             /* sum[i] of the coefficients of i, ... */
+    bdd_level_t *levels;
+    bdd_node_t *nodes;          /* children before their parents */
+    int nnodes, snodes;
+    int nintervals;
+    int nomem, full;
+} bdd_t;
+
+static int bdd_node(bdd_t *bdd, int i, long long k, long long *lo,
+                    long long *hi)
+{
+    bdd_level_t *level = bdd->levels + i;
+    interval_t *iv;
+    bdd_node_t *nodes;
+    long long c, lo1, hi1;
+    int node0, node1, node, l = 0, r, m;
+
+    if (bdd->nomem || bdd->full)
+        return BDD_TRUE;
+    if (k < 0) {
+        *lo = LLONG_MIN;
+        *hi = -1;
+        return BDD_FALSE;
+    }
+    if (k >= bdd->sum[i]) {
+        *lo = bdd->sum[i];
+        *hi = LLONG_MAX;
+        return BDD_TRUE;
+    }
+    /* the last interval with lo <= k */
+    r = level->n;
+    while (l < r) {
+        m = (l + r) / 2;
+        if (level->iv[m].lo <= k)
+            l = m + 1;
+        else
+            r = m;
+    }
+    if (l && k <= level->iv[l - 1].hi) {
+        *lo = level->iv[l - 1].lo;
+        *hi = level->iv[l - 1].hi;
+        return level->iv[l - 1].node;
+    }
+
+    c = bdd->terms[i].coef;
+    node0 = bdd_node(bdd, i + 1, k, lo, hi);
+    node1 = bdd_node(bdd, i + 1, k - c, &lo1, &hi1);
+    if (bdd->nomem || bdd->full)
+        return BDD_TRUE;
+    if (lo1 != LLONG_MIN && lo1 + c > *lo)
+        *lo = lo1 + c;
+    if (hi1 != LLONG_MAX && hi1 + c < *hi)
+        *hi = hi1 + c;
+
+    if (++bdd->nintervals > BDD_MAX_NODES) {
+        bdd->full = 1;
+        return BDD_TRUE;
+    }
+    if (node0 == node1)
+        node = node0;
+    else {
+        if (bdd->nnodes == bdd->snodes) {
+            m = 2 * bdd->snodes + 16;
+            nodes = realloc(bdd->nodes, m * sizeof(bdd_node_t));
+            if (nodes == NULL) {
+                bdd->nomem = 1;
+                return BDD_TRUE;
+            }
+            bdd->nodes = nodes;
+            bdd->snodes = m;
+        }
+        node = bdd->nnodes++;
+        bdd->nodes[node].level = i;
+        bdd->nodes[node].node0 = node0;
+        bdd->nodes[node].node1 = node1;
+    }
+
+    if (level->n == level->size) {
+        m = 2 * level->size + 4;
+        if ((iv = realloc(level->iv, m * sizeof(interval_t))) == NULL) {
+            bdd->nomem = 1;
+            return BDD_TRUE;
+        }
+        level->iv = iv;
+        level->size = m;
+    }
+    iv = level->iv + l;
+    memmove(iv + 1, iv, (level->n - l) * sizeof(interval_t));
+    iv->lo = *lo;
+    iv->hi = *hi;
+    iv->node = node;
+    level->n++;
+    return node;
+}
+
+/* Encode the n terms (of positive coefficients, which sum up to more than
+   rhs >= 0) summing up to at most rhs by a BDD.  Return -1 when out of
+   memory, and 1 when the BDD is too large (and nothing was added). */
+static int bdd_encode(PicoSAT *picosat, const pbterm_t *terms, int n,
+                      long long rhs)
+{
+    bdd_t bdd;
+    bdd_node_t *node;
+    long long lo, hi;
+    int *lit = NULL, i, root, res = 1;
+
+    memset(&bdd, 0, sizeof(bdd_t));
+    bdd.terms = terms;
+    bdd.sum = malloc((n + 1) * sizeof(long long));
+    bdd.levels = calloc(n + 1, sizeof(bdd_level_t));
+    if (bdd.sum == NULL || bdd.levels == NULL) {
+        res = -1;
+        goto done;
+    }
+    bdd.sum[n] = 0;
+    for (i = n - 1; i >= 0; i--)
+        bdd.sum[i] = bdd.sum[i + 1] + terms[i].coef;
+
+    root = bdd_node(&bdd, 0, rhs, &lo, &hi);
+    if (bdd.nomem || (!bdd.full &&
+                      (lit = malloc(bdd.nnodes * sizeof(int))) == NULL)) {
+        res = -1;
+        goto done;
+    }
+    if (bdd.full)
+        goto done;
+
+    for (i = 0; i < bdd.nnodes; i++) {
+        node = bdd.nodes + i;
+        lit[i] = picosat_inc_max_var(picosat);
+        if (node->node1 != BDD_TRUE)
+            add_clause3(picosat, -lit[i], -terms[node->level].lit,
+                        node->node1 == BDD_FALSE ? 0 : lit[node->node1]);
+        if (node->node0 != BDD_TRUE)
+            add_clause3(picosat, -lit[i], lit[node->node0], 0);
+    }
+    assert(root >= 0);
+    add_clause3(picosat, lit[root], 0, 0);
+    res = 0;
+
+done:
+    if (bdd.levels)
+        for (i = 0; i <= n; i++)
+            free(bdd.levels[i].iv);
+    free(bdd.levels);
+    free(bdd.nodes);
+    free(bdd.sum);
+    free(lit);
+    return res;
+}
+
+/* Encode the n terms (of positive coefficients) summing up to at most
+   rhs >= 0 by adders: each literal is put into the buckets of the bits
+   of its coefficient, and each bucket is reduced to a single bit by full
+   and half adders, whose carries go to the next bucket.  The sum and
+   carry of an adder are implied by its inputs, so the bits make up at
+   least the sum, which is then compared to rhs bit by bit. */
+#define ADDER_BITS  64
+
+static int adder_encode(PicoSAT *picosat, const pbterm_t *terms, int n,
+                        long long rhs)
+{
+    int *bucket[ADDER_BITS], count[ADDER_BITS], size[ADDER_BITS];
+    int out[ADDER_BITS], *tmp, i, j, b, x, y, z, s, c, res = -1;
+
+    memset(bucket, 0, sizeof(bucket));
+    memset(count, 0, sizeof(count));
+    memset(size, 0, sizeof(size));
+
+#define ADDER_PUSH(bit, lit)  do {                                      \
+        if (count[bit] == size[bit]) {                                  \
+            size[bit] = 2 * size[bit] + 8;                              \
+            tmp = realloc(bucket[bit], size[bit] * sizeof(int));        \
+            if (tmp == NULL)                                            \
+                goto done;                                              \
+            bucket[bit] = tmp;                                          \
+        }                                                               \
+        bucket[bit][count[bit]++] = (lit);                              \
+    } while (0)
+
+    for (i = 0; i < n; i++)
+        for (b = 0; b < ADDER_BITS - 2; b++)
+            if (terms[i].coef >> b & 1)
+                ADDER_PUSH(b, terms[i].lit);
+
+    for (b = 0; b < ADDER_BITS; b++) {
+        /* as a queue, such that the adders make a balanced tree */
+        for (j = 0; count[b] - j >= 2; j += (z ? 3 : 2)) {
+            x = bucket[b][j];
+            y = bucket[b][j + 1];
+            z = count[b] - j >= 3 ? bucket[b][j + 2] : 0;
+            s = picosat_inc_max_var(picosat);
+            c = picosat_inc_max_var(picosat);
+            assert(b + 1 < ADDER_BITS);
+            add_clause3(picosat, -x, -y, c);
+            if (z) {
+                add_clause3(picosat, -x, -z, c);
+                add_clause3(picosat, -y, -z, c);
+                picosat_add_arg(picosat, -x, y, z, s, 0);
+                picosat_add_arg(picosat, x, -y, z, s, 0);
+                picosat_add_arg(picosat, x, y, -z, s, 0);
+                picosat_add_arg(picosat, -x, -y, -z, s, 0);
+            }
+            else {
+                add_clause3(picosat, -x, y, s);
+                add_clause3(picosat, x, -y, s);
+            }
+            ADDER_PUSH(b, s);
+            ADDER_PUSH(b + 1, c);
+        }
+        out[b] = count[b] > j ? bucket[b][j] : 0;
+    }
+#undef ADDER_PUSH
+
+    /* a bit which is set where rhs has a 0 makes the sum too large,
+       unless a higher bit is clear where rhs has a 1 */
+    for (b = 0; b < ADDER_BITS; b++) {
+        if (out[b] == 0 || (rhs >> b & 1))
+            continue;
+        picosat_add(picosat, -out[b]);
+        for (j = b + 1; j < ADDER_BITS; j++)
+            if (out[j] && (rhs >> j & 1))
+                picosat_add(picosat, -out[j]);
+        picosat_add(picosat, 0);
+    }
+    res = 0;
+
+done:
+    for (b = 0; b < ADDER_BITS; b++)
+        free(bucket[b]);
+    return res;
+}
+
+/* Add the constraint that the sum of the n terms (of any sign, which are
+   normalized in place) is at most rhs.  Return -1 when out of memory. */
+static int pb_atmost(PicoSAT *picosat, pbterm_t *terms, int n,
+                     long long rhs)
+{
+    long long sum = 0;
+    int *lits, i, m;
+
+    /* coef * -v is coef - coef * v, so all terms are made positive
+       literals, and those of the same variable are added up */
+    for (i = 0; i < n; i++)
+        if (terms[i].lit < 0) {
+            rhs -= terms[i].coef;
+            terms[i].coef = -terms[i].coef;
+            terms[i].lit = -terms[i].lit;
+        }
+    qsort(terms, n, sizeof(pbterm_t), pb_cmp_var);
+    for (m = 0, i = 0; i < n; i++) {
+        if (m && terms[m - 1].lit == terms[i].lit)
+            terms[m - 1].coef += terms[i].coef;
+        else
+            terms[m++] = terms[i];
+    }
+    /* then negative coefficients are made positive the same way, and
+       terms which alone exceed rhs are false */
+    for (n = 0, i = 0; i < m; i++) {
+        if (terms[i].coef < 0) {
+            rhs -= terms[i].coef;
+            terms[i].coef = -terms[i].coef;
+            terms[i].lit = -terms[i].lit;
+        }
+        if (terms[i].coef)
+            terms[n++] = terms[i];
+    }
+    if (rhs < 0) {
+        picosat_add(picosat, 0);
+        return 0;
+    }
+    for (m = 0, i = 0; i < n; i++) {
+        if (terms[i].coef > rhs)
+            add_clause3(picosat, -terms[i].lit, 0, 0);
+        else {
+            sum += terms[i].coef;
+            terms[m++] = terms[i];
+        }
+    }
+    n = m;
+    if (sum <= rhs)
+        return 0;
+
+    for (i = 1; i < n && terms[i].coef == terms[0].coef; i++)
+        ;
+    if (i == n) {               /* a cardinality constraint */
+        if ((lits = malloc(n * sizeof(int))) == NULL)
+            return -1;
+        for (i = 0; i < n; i++)
+            lits[i] = terms[i].lit;
+        i = card_constraint(picosat, lits, n, (int) (rhs / terms[0].coef),
+                            CARD_UPPER);
+        free(lits);
+        return i;
+    }
+    /* large coefficients first make the BDD smaller */
+    qsort(terms, n, sizeof(pbterm_t), pb_cmp_coef);
+    if ((i = bdd_encode(picosat, terms, n, rhs)) <= 0)
+        return i;
+    return adder_encode(picosat, terms, n, rhs);
+}
+
+/*************************** Solver object *************************/
+
+/* A Solver wraps a single PicoSAT instance which lives as long as the
+   Python object.  Clauses may be added between calls to solve(), and
+   everything picosat learned in earlier calls (learned clauses, variable
+   scores and saved phases) is reused by later ones.  The auxiliary
+   variables of cardinality and pseudo-Boolean constraints are left out of
+   its solutions. */
+typedef struct {
+    PyObject_HEAD
+    PicoSAT *picosat;
+    unsigned long long prop_limit;  /* propagations per solve(), 0 = none */
+    int res;                    /* result of last solve(), 0 once the
+                                   solver was modified afterwards */
+    double deadline;            /* of the current call, see get_deadline() */
+    unsigned char *aux;         /* aux[v] for auxiliary variables v */
+    int saux;                   /* size of aux */
+    int busy;                   /* picosat is in use by a call which
+                                   released the GIL (or runs Python code) */
+} solverobject;
+
+static PyTypeObject Solver_Type;
+
+#define Solver_Check(op)  PyObject_TypeCheck(op, &Solver_Type)
+
+static PyObject* solver_new(PyTypeObject *type, PyObject *args,
+                            PyObject *kwds)
+{
+    solverobject *self;
+    PyObject *clauses = NULL;   /* optional iterable of clauses */
+    int vars = -1, verbose = 0;
+    unsigned long long prop_limit = 0;
+    static char* kwlist[] = {"clauses",
+                             "vars", "verbose", "prop_limit", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OiiK:Solver", kwlist,
+                                     &clauses,
+                                     &vars, &verbose, &prop_limit))
+        return NULL;
+
+    self = (solverobject *) type->tp_alloc(type, 0);
+    if (self == NULL)
+        return NULL;
+
+    self->picosat = new_picosat(vars, verbose, 0);
+    self->prop_limit = prop_limit;
+    self->deadline = 0.0;
+    picosat_set_interrupt(self->picosat, &self->deadline, deadline_passed);
+
+    if (clauses != NULL && clauses != Py_None &&
+            add_clauses(self->picosat, clauses) < 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *) self;
+}
+
+static void solver_dealloc(solverobject *self)
+{
+    if (self->picosat)
+        picosat_reset(self->picosat);
+    free(self->aux);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+/* Raise RuntimeError when picosat is used by another call to the solver,
+   e.g. from another thread while solve() runs without the GIL, as picosat
+   itself is not reentrant.  Called right before picosat is used, after
+   converting the arguments (which may run Python code). */
+static int solver_in_use(solverobject *self)
+{
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "Solver is in use");
+        return -1;
+    }
+    return 0;
+}
+
+/* Make sure that the solver is not in use, and that none of the n
+   literals is an auxiliary variable, as these are numbered like the
+   others. */
+static int solver_check_lits(solverobject *self, const int *lits,
+                             Py_ssize_t n)
+{
+    Py_ssize_t i;
+    int v;
+
+    if (solver_in_use(self) < 0)
+        return -1;
+    for (i = 0; i < n && self->aux; i++) {
+        v = abs(lits[i]);
+        if (v < self->saux && self->aux[v]) {
+            PyErr_Format(PyExc_ValueError, "variable %d is an auxiliary "
+                         "variable of a constraint (reserve variables "
+                         "by passing vars to Solver)", v);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Make sure that the solver is not in use, and that the variables of the
+   n assumptions (zeros are skipped) are known to picosat, as assuming a
+   new variable would add it (and all before it) to later solutions.
+   Unlike in clauses, auxiliary variables (e.g. the outputs of a
+   totalizer) are fine. */
+static int solver_check_assumptions(solverobject *self, const int *lits,
+                                    Py_ssize_t n)
+{
+    int max_idx = picosat_variables(self->picosat);
+    Py_ssize_t i;
+
+    if (solver_in_use(self) < 0)
+        return -1;
+    for (i = 0; i < n; i++)
+        if (abs(lits[i]) > max_idx) {
+            PyErr_Format(PyExc_ValueError, "assumption %d on unknown "
+                         "variable (reserve variables by passing vars "
+                         "to Solver)", lits[i]);
+            return -1;
+        }
+    return 0;
+}
+
+static PyObject* solver_add_clause(solverobject *self, PyObject *clause)
+{
+    int stack[CLAUSE_STACK_SIZE], *lits;
+    Py_ssize_t n;
+
+    if ((n = get_lits(clause, stack, &lits)) < 0)
+        return NULL;
+    if (solver_check_lits(self, lits, n) < 0) {
+        free_lits(lits, stack);
+        return NULL;
+    }
+    self->res = 0;
+    picosat_add_clauses(self->picosat, lits, (size_t) n + 1);
+    free_lits(lits, stack);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(solver_add_clause_doc,
+"add_clause(clause)\n\
+\n\
+Add a single clause (an iterable of non-zero integers) to the solver.");
+
+static PyObject* solver_add_clauses(solverobject *self, PyObject *clauses)
+{
+    Py_ssize_t n;
+    int *stream, res;
+
+    if (self->aux == NULL) {
+        /* the clauses are added while iterating over them, which may run
+           Python code, and buffers are added without the GIL */
+        if (solver_in_use(self) < 0)
+            return NULL;
+        self->busy = 1;
+        self->res = 0;
+        res = add_clauses(self->picosat, clauses);
+        self->busy = 0;
+        if (res < 0)
+            return NULL;
+        Py_RETURN_NONE;
+    }
+    /* all clauses are checked before the first one is added */
+    if ((stream = get_stream(clauses, &n)) == NULL)
+        return NULL;
+    if (solver_check_lits(self, stream, n) < 0) {
+        PyMem_RawFree(stream);
+        return NULL;
+    }
+    self->res = 0;
+    picosat_add_clauses(self->picosat, stream, (size_t) n);
+    PyMem_RawFree(stream);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(solver_add_clauses_doc,
+"add_clauses(clauses)\n\
+\n\
+Add an iterable of clauses to the solver.");
+
+static PyObject* solver_add_xor(solverobject *self, PyObject *args,
+                                PyObject *kwds)
+{
+    PyObject *obj;
+    int stack[CLAUSE_STACK_SIZE], *lits;
+    Py_ssize_t n;
+    int rhs = 1;
+    static char* kwlist[] = {"lits", "rhs", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i:add_xor", kwlist,
+                                     &obj, &rhs))
+        return NULL;
+
+    if ((n = get_lits(obj, stack, &lits)) < 0)
+        return NULL;
+    if (solver_check_lits(self, lits, n) < 0) {
+        free_lits(lits, stack);
+        return NULL;
+    }
+    self->res = 0;
+    add_xor_constraint(self->picosat, lits, n, rhs != 0);
+    free_lits(lits, stack);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(solver_add_xor_doc,
+"add_xor(lits [, rhs])\n\
+\n\
+Add the constraint that the xor (sum modulo 2) of the literals is rhs\n\
+(default True) to the solver.  Unlike its CNF encoding, which needs\n\
+2**(len(lits) - 1) clauses, the constraint is propagated natively, and\n\
+Gaussian elimination (on decision level zero only) derives the units and\n\
+equivalences implied by all xor constraints of the solver.");
+
+/* Make sure picosat knows the variables of the n literals, such that the
+   variables added by an encoding of them are all auxiliary ones, and
+   return the first of those. */
+static int solver_reserve(solverobject *self, const int *lits, Py_ssize_t n)
+{
+    int max_idx = picosat_variables(self->picosat), i;
+
+    for (i = 0; i < n; i++)
+        if (abs(lits[i]) > max_idx)
+            max_idx = abs(lits[i]);
+    if (max_idx > picosat_variables(self->picosat))
+        picosat_adjust(self->picosat, max_idx);
+    return max_idx + 1;
+}
+
+/* mark the variables from first on as auxiliary ones, return -1 when out
+   of memory */
+static int solver_mark_aux(solverobject *self, int first)
+{
+    int max_idx = picosat_variables(self->picosat), size;
+    unsigned char *aux;
+
+    if (first > max_idx)
+        return 0;
+    if (max_idx >= self->saux) {
+        size = 2 * max_idx + 16;
+        if ((aux = realloc(self->aux, size)) == NULL)
+            return -1;
+        memset(aux + self->saux, 0, size - self->saux);
+        self->aux = aux;
+        self->saux = size;
+    }
+    memset(self->aux + first, 1, max_idx - first + 1);
+    return 0;
+}
+
+/* set the values of auxiliary variables to 0, so they are left out */
+static void solver_hide_aux(solverobject *self, signed char *vals,
+                            int max_idx)
+{
+    int i;
+
+    for (i = 1; i <= max_idx && i < self->saux; i++)
+        if (self->aux[i])
+            vals[i] = 0;
+}
+
+/* return the solution found by the last call to solve(), without the
+   auxiliary variables */
+static PyObject* solver_solution(solverobject *self, int output)
+{
+    PyObject *res;
+    signed char *vals;
+    int max_idx;
+
+    max_idx = picosat_variables(self->picosat);
+    vals = PyMem_Malloc(max_idx + 1);
+    if (vals == NULL)
+        return PyErr_NoMemory();
+    get_values(self->picosat, vals, max_idx);
+    solver_hide_aux(self, vals, max_idx);
+    res = new_solution(vals, max_idx, output);
+    PyMem_Free(vals);
+    return res;
+}
+
+/* Add the constraint that at most and/or at least (by dirs) k of the
+   literals of obj are true. */
+static PyObject* solver_card(solverobject *self, PyObject *obj, int k,
+                             int dirs)
+{
+    int stack[CLAUSE_STACK_SIZE], *lits;
+    Py_ssize_t n;
+    int res;
+
+    if ((n = get_lits(obj, stack, &lits)) < 0)
+        return NULL;
+    if (solver_check_lits(self, lits, n) < 0) {
+        free_lits(lits, stack);
+        return NULL;
+    }
+    if (n > INT_MAX / 2) {
+        free_lits(lits, stack);
+        PyErr_SetString(PyExc_OverflowError, "too many literals");
+        return NULL;
+    }
+    self->res = 0;
+    res = card_constraint(self->picosat, lits, (int) n, k, dirs);
+    free_lits(lits, stack);
+    if (res < 0)
+        return PyErr_NoMemory();
+    Py_RETURN_NONE;
+}
+
+static PyObject* solver_add_atmost(solverobject *self, PyObject *args,
+                                   PyObject *kwds)
+{
+    PyObject *lits;
+    int k;
+    static char* kwlist[] = {"lits", "k", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oi:add_atmost", kwlist,
+                                     &lits, &k))
+        return NULL;
+    return solver_card(self, lits, k, CARD_UPPER);
+}
+
+PyDoc_STRVAR(solver_add_atmost_doc,
+"add_atmost(lits, k)\n\
+\n\
+Add the constraint that at most k of the literals are true.  It is\n\
+propagated natively by picosat, without any auxiliary variables.");
+
+static PyObject* solver_add_atleast(solverobject *self, PyObject *args,
+                                    PyObject *kwds)
+{
+    PyObject *lits;
+    int k;
+    static char* kwlist[] = {"lits", "k", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oi:add_atleast", kwlist,
+                                     &lits, &k))
+        return NULL;
+    return solver_card(self, lits, k, CARD_LOWER);
+}
+
+PyDoc_STRVAR(solver_add_atleast_doc,
+"add_atleast(lits, k)\n\
+\n\
+Add the constraint that at least k of the literals are true, which\n\
+is at most len(lits) - k of their negations (see add_atmost).");
+
+static PyObject* solver_add_exactly(solverobject *self, PyObject *args,
+                                    PyObject *kwds)
+{
+    PyObject *lits;
+    int k;
+    static char* kwlist[] = {"lits", "k", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oi:add_exactly", kwlist,
+                                     &lits, &k))
+        return NULL;
+    return solver_card(self, lits, k, CARD_UPPER | CARD_LOWER);
+}
+
+PyDoc_STRVAR(solver_add_exactly_doc,
+"add_exactly(lits, k)\n\
+\n\
+Add the constraint that exactly k of the literals are true, as both\n\
+add_atmost and add_atleast.");
+
+/* largest sum of absolute values of the coefficients and rhs of add_pb */
+#define PB_MAX_SUM  (LLONG_MAX / 4)
+
+static PyObject* solver_add_pb(solverobject *self, PyObject *args,
+                               PyObject *kwds)
+{
+    PyObject *coeffs, *lits_obj, *fast = NULL;
+    int stack[CLAUSE_STACK_SIZE], *lits;
+    pbterm_t *terms = NULL;
+    Py_ssize_t n, i;
+    long long rhs, c, sum;
+    const char *op;
+    int first, res = 0, le, ge;
+    static char* kwlist[] = {"coeffs", "lits", "op", "rhs", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOsL:add_pb", kwlist,
+                                     &coeffs, &lits_obj, &op, &rhs))
+        return NULL;
+
+    /* before any arithmetic on rhs, which must not overflow */
+    if (rhs > PB_MAX_SUM || rhs < -PB_MAX_SUM) {
+        PyErr_SetString(PyExc_OverflowError, "rhs too large");
+        return NULL;
+    }
+    le = !strcmp(op, "<=") || !strcmp(op, "<") || !strcmp(op, "==");
+    ge = !strcmp(op, ">=") || !strcmp(op, ">") || !strcmp(op, "==");
+    if (!le && !ge) {
+        PyErr_Format(PyExc_ValueError, "unknown operator: '%s'", op);
+        return NULL;
+    }
+    if (!strcmp(op, "<"))
+        rhs--;
+    else if (!strcmp(op, ">"))
+        rhs++;
+
+    if ((n = get_lits(lits_obj, stack, &lits)) < 0)
+        return NULL;
+    if (solver_check_lits(self, lits, n) < 0)
+        goto error;
+    if (n > INT_MAX / 4) {
+        PyErr_SetString(PyExc_OverflowError, "too many literals");
+        goto error;
+    }
+    if ((fast = PySequence_Fast(coeffs, "coeffs must be a sequence")) == NULL)
+        goto error;
+    if (PySequence_Fast_GET_SIZE(fast) != n) {
+        PyErr_SetString(PyExc_ValueError,
+                        "coeffs and lits must have the same length");
+        goto error;
+    }
+    if ((terms = malloc(2 * (n + 1) * sizeof(pbterm_t))) == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    sum = rhs < 0 ? -rhs : rhs;
+    for (i = 0; i < n; i++) {
+        c = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(fast, i));
+        if (c == -1 && PyErr_Occurred())
+            goto error;
+        if (c > PB_MAX_SUM || c < -PB_MAX_SUM ||
+                (sum += c < 0 ? -c : c) > PB_MAX_SUM) {
+            PyErr_SetString(PyExc_OverflowError, "coefficients too large");
+            goto error;
+        }
+        terms[i].coef = c;
+        terms[i].lit = lits[i];
+        /* the negated terms for the lower bound */
+        terms[n + i].coef = -c;
+        terms[n + i].lit = lits[i];
+    }
+
+    /* converting the coefficients may have run Python code */
+    if (solver_in_use(self) < 0)
+        goto error;
+    self->res = 0;
+    first = solver_reserve(self, lits, n);
+    if (le)
+        res = pb_atmost(self->picosat, terms, (int) n, rhs);
+    if (ge && res == 0)
+        res = pb_atmost(self->picosat, terms + n, (int) n, -rhs);
+    if (res < 0 || solver_mark_aux(self, first) < 0) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    Py_DECREF(fast);
+    free(terms);
+    free_lits(lits, stack);
+    Py_RETURN_NONE;
+
+error:
+    Py_XDECREF(fast);
+    free(terms);
+    free_lits(lits, stack);
+    return NULL;
+}
+
+PyDoc_STRVAR(solver_add_pb_doc,
+"add_pb(coeffs, lits, op, rhs)\n\
+\n\
+Add the pseudo-Boolean constraint that the sum of coeffs[i] for the true\n\
+literals lits[i] compares to rhs by op, which is one of '<=', '<', '>=',\n\
+'>' and '=='.  Coefficients are integers of any sign.  Constraints with\n\
+equal coefficients are cardinality constraints (see add_atmost), other\n\
+ones are encoded as BDDs, whose auxiliary variables are left out of the\n\
+solutions.  OverflowError is raised when the sum of the absolute values\n\
+of the coefficients and rhs exceeds 2**61 - 1.");
+
+/* A Totalizer counts its input literals for a Solver, by a totalizer
+   whose outputs are encoded in both directions, such that out[k] is true
+   exactly when more than k inputs are.  Bounds on the number of true
+   inputs are set by assuming an output, and outputs are only added as far
+   as bounds were asked for.  New inputs are counted by a new root, whose
+   children are the old root and the totalizer of the new inputs. */
+typedef struct {
+    PyObject_HEAD
+    solverobject *solver;
+    totalizer_t *root;          /* NULL without inputs */
+    int false_lit;              /* a literal which is false, 0 until used */
+} totobject;
+
+static PyTypeObject Totalizer_Type;
+
+static void tot_dealloc(totobject *self)
+{
+    tot_free(self->root);
+    Py_XDECREF(self->solver);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+/* count the literals of obj as well, return -1 on error */
+static int tot_add_inputs(totobject *self, PyObject *obj)
+{
+    solverobject *solver = self->solver;
+    int stack[CLAUSE_STACK_SIZE], *lits;
+    totalizer_t *sub, *root;
+    Py_ssize_t n;
+
+    if ((n = get_lits(obj, stack, &lits)) < 0)
+        return -1;
+    if (solver_check_lits(solver, lits, n) < 0)
+        goto error;
+    if (n > INT_MAX - (self->root ? self->root->n : 0)) {
+        PyErr_SetString(PyExc_OverflowError, "too many literals");
+        goto error;
+    }
+    if (n == 0) {
+        free_lits(lits, stack);
+        return 0;
+    }
+    solver_reserve(solver, lits, n);
+    if ((sub = tot_new(lits, (int) n)) == NULL)
+        goto nomem;
+    if (self->root == NULL)
+        self->root = sub;
+    else {
+        if ((root = calloc(1, sizeof(totalizer_t))) == NULL) {
+            tot_free(sub);
+            goto nomem;
+        }
+        root->left = self->root;
+        root->right = sub;
+        root->n = self->root->n + sub->n;
+        self->root = root;
+    }
+    free_lits(lits, stack);
+    return 0;
+
+nomem:
+    PyErr_NoMemory();
+error:
+    free_lits(lits, stack);
+    return -1;
+}
+
+/* return the literal of the bound that more than k inputs are true (or
+   its negation when neg), built as far as needed */
+static PyObject* tot_output(totobject *self, int k, int neg)
+{
+    solverobject *solver = self->solver;
+    int n = self->root ? self->root->n : 0, first, lit;
+
+    if (solver_in_use(solver) < 0)
+        return NULL;
+    first = picosat_variables(solver->picosat) + 1;
+    if (k < 0 || k >= n) {
+        if (self->false_lit == 0) {
+            self->false_lit = picosat_inc_max_var(solver->picosat);
+            picosat_add_arg(solver->picosat, -self->false_lit, 0);
+        }
+        lit = k < 0 ? -self->false_lit : self->false_lit;
+    }
+    else {
+        if (tot_grow(solver->picosat, self->root, k + 1,
+                     CARD_UPPER | CARD_LOWER) < 0)
+            return PyErr_NoMemory();
+        lit = self->root->out[k];
+    }
+    solver->res = 0;
+    if (solver_mark_aux(solver, first) < 0)
+        return PyErr_NoMemory();
+    return PyInt_FromLong((long) (neg ? -lit : lit));
+}
+
+static PyObject* tot_extend_method(totobject *self, PyObject *lits)
+{
+    if (tot_add_inputs(self, lits) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(tot_extend_doc,
+"extend(lits)\n\
+\n\
+Count the literals as well.  Literals returned by at_most and at_least\n\
+before still bound the number of the inputs counted at that time.");
+
+static PyObject* tot_at_most(totobject *self, PyObject *args)
+{
+    int k;
+
+    if (!PyArg_ParseTuple(args, "i:at_most", &k))
+        return NULL;
+    return tot_output(self, k, 1);
+}
+
+PyDoc_STRVAR(tot_at_most_doc,
+"at_most(k) -> int\n\
+\n\
+Return a literal which, when assumed in Solver.solve(), restricts the\n\
+number of true inputs to at most k.");
+
+static PyObject* tot_at_least(totobject *self, PyObject *args)
+{
+    int k;
+
+    if (!PyArg_ParseTuple(args, "i:at_least", &k))
+        return NULL;
+    return tot_output(self, k - 1, 0);
+}
+
+PyDoc_STRVAR(tot_at_least_doc,
+"at_least(k) -> int\n\
+\n\
+Return a literal which, when assumed in Solver.solve(), requires at\n\
+least k inputs to be true.");
+
+static Py_ssize_t tot_length(totobject *self)
+{
+    return self->root ? self->root->n : 0;
+}
+
+static PySequenceMethods tot_as_sequence = {
+    (lenfunc) tot_length,                     /* sq_length */
+};
+
+static PyMethodDef tot_methods[] = {
+    {"extend",   (PyCFunction) tot_extend_method, METH_O, tot_extend_doc},
+    {"at_most",  (PyCFunction) tot_at_most,  METH_VARARGS, tot_at_most_doc},
+    {"at_least", (PyCFunction) tot_at_least, METH_VARARGS, tot_at_least_doc},
+    {NULL,       NULL}  /* sentinel */
+};
+
+PyDoc_STRVAR(tot_doc,
+"Totalizer counting literals for a Solver, see Solver.totalizer().");
+
+static PyTypeObject Totalizer_Type = {
+#ifdef IS_PY3K
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                        /* ob_size */
+#endif
+    "pycosat.Totalizer",                      /* tp_name */
+    sizeof(totobject),                        /* tp_basicsize */
+    0,                                        /* tp_itemsize */
+    /* methods */
+    (destructor) tot_dealloc,                 /* tp_dealloc */
+    0,                                        /* tp_print */
+    0,                                        /* tp_getattr */
+    0,                                        /* tp_setattr */
+    0,                                        /* tp_compare */
+    0,                                        /* tp_repr */
+    0,                                        /* tp_as_number */
+    &tot_as_sequence,                         /* tp_as_sequence */
+    0,                                        /* tp_as_mapping */
+    0,                                        /* tp_hash */
+    0,                                        /* tp_call */
+    0,                                        /* tp_str */
+    PyObject_GenericGetAttr,                  /* tp_getattro */
+    0,                                        /* tp_setattro */
+    0,                                        /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    tot_doc,                                  /* tp_doc */
+    0,                                        /* tp_traverse */
+    0,                                        /* tp_clear */
+    0,                                        /* tp_richcompare */
+    0,                                        /* tp_weaklistoffset */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    tot_methods,                              /* tp_methods */
+};
+
+static PyObject* solver_totalizer(solverobject *self, PyObject *args,
+                                  PyObject *kwds)
+{
+    PyObject *lits = NULL;
+    totobject *tot;
+    static char* kwlist[] = {"lits", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:totalizer", kwlist,
+                                     &lits))
+        return NULL;
+
+    tot = PyObject_New(totobject, &Totalizer_Type);
+    if (tot == NULL)
+        return NULL;
+    Py_INCREF(self);
+    tot->solver = self;
+    tot->root = NULL;
+    tot->false_lit = 0;
+    if (lits != NULL && lits != Py_None && tot_add_inputs(tot, lits) < 0) {
+        Py_DECREF(tot);
+        return NULL;
+    }
+    return (PyObject *) tot;
+}
+
+PyDoc_STRVAR(solver_totalizer_doc,
+"totalizer([lits]) -> Totalizer\n\
+\n\
+Return a Totalizer, which counts the literals (and the ones added by its\n\
+extend method).  Its methods at_most(k) and at_least(k) return literals\n\
+to pass as assumptions to solve(), which bound the number of true inputs\n\
+for that call only.  The totalizer is only encoded as far as needed for\n\
+the bounds asked for, and is reused by later bounds, whose auxiliary\n\
+variables are left out of the solutions.");
+
+static PyObject* solver_load_dimacs(solverobject *self, PyObject *path)
+{
+    int res;
+
+    if (solver_in_use(self) < 0)
+        return NULL;
+    self->busy = 1;
+    self->res = 0;
+    res = load_dimacs(self->picosat, path);
+    self->busy = 0;
+    if (res < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(solver_load_dimacs_doc,
+"load_dimacs(path)\n\
+\n\
+Add the clauses from a DIMACS CNF file (which may be gzip compressed)\n\
+to the solver.");
+
+static PyObject* solver_solve(solverobject *self, PyObject *args,
+                              PyObject *kwds)
+{
+    PicoSAT *picosat = self->picosat;
+    PyObject *assumptions = NULL;
+    PyObject *timeout = NULL, *deadline = NULL;
+    int stack[CLAUSE_STACK_SIZE], *lits;
+    Py_ssize_t n, i;
+    int output, res;
+    double d;
+    const char *output_name = NULL;
+    static char* kwlist[] = {"assumptions", "output",
+                             "timeout", "deadline", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OzOO:solve", kwlist,
+                                     &assumptions, &output_name,
+                                     &timeout, &deadline))
+        return NULL;
+
+    if ((output = get_output(output_name)) < 0)
+        return NULL;
+
+    if (get_deadline(timeout, deadline, &d) < 0)
+        return NULL;
+
+    /* all assumptions are checked before the first one is passed on */
+    if (assumptions != NULL && assumptions != Py_None) {
+        if ((n = get_lits(assumptions, stack, &lits)) < 0)
+            return NULL;
+        if (solver_check_assumptions(self, lits, n) < 0) {
+            free_lits(lits, stack);
+            return NULL;
+        }
+        for (i = 0; i < n; i++)
+            picosat_assume(picosat, lits[i]);
+        free_lits(lits, stack);
+    }
+    else if (solver_in_use(self) < 0)
+        return NULL;
+
+    self->deadline = d;
+    if (self->prop_limit)
+        picosat_set_propagation_limit(picosat, picosat_propagations(picosat)
+                                               + self->prop_limit);
+
+    self->busy = 1;
     Py_BEGIN_ALLOW_THREADS      /* release GIL */
-    res = picosat_sat(it->picosat, -1);
+    res = picosat_sat(picosat, -1);
     Py_END_ALLOW_THREADS
+    self->busy = 0;
 
-    switch (res) {
-    case PICOSAT_SATISFIABLE:
-        result = get_solution(it->picosat);
-        if (result == NULL) {
-            PyErr_SetString(PyExc_SystemError, "failed to create list");
-            return NULL;
+    self->res = res;
+    if (res == PICOSAT_SATISFIABLE && self->aux)
+        return solver_solution(self, output);
+    return get_result(picosat, res, output);
+}
+
+PyDoc_STRVAR(solver_solve_doc,
+"solve([assumptions, output, timeout, deadline]) -> list\n\
+\n\
+Solve the SAT problem for all clauses added so far, and return a solution\n\
+(by default a list of integers), or one of the strings \"UNSAT\",\n\
+\"UNKNOWN\".\n\
+The optional assumptions are literals, which are assumed to be true for\n\
+this call only (like unit clauses, which are not kept).  When the timeout\n\
+(in seconds) or deadline (in time.monotonic() time) is reached, \"UNKNOWN\"\n\
+is returned.\n\
+The solver state is kept, such that clauses can be added and solve()\n\
+called again.");
+
+static PyObject* solver_solve_batch(solverobject *self, PyObject *args,
+                                    PyObject *kwds)
+{
+    PicoSAT *picosat = self->picosat;
+    PyObject *queries;          /* iterable of assumption lists, or buffer */
+    PyObject *results = NULL, *models = NULL, *item;
+    PyObject *timeout = NULL, *deadline = NULL;
+    int *stream, *p, *end;
+    signed char *codes = NULL;  /* 1 = SAT, 0 = UNSAT, -1 = UNKNOWN */
+    signed char *vals = NULL;   /* values of all models, one after another */
+    Py_ssize_t *offsets = NULL; /* models[i] starts at vals + offsets[i] */
+    int *max_idx = NULL;        /* ... and has max_idx[i] variables */
+    Py_ssize_t n, nq = 0, q, used = 0, size = 0;
+    int with_models = 0, output, res = 0, nomem = 0;
+    double d;
+    const char *output_name = NULL;
+    static char* kwlist[] = {"queries", "models", "output",
+                             "timeout", "deadline", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|izOO:solve_batch",
+                                     kwlist, &queries, &with_models,
+                                     &output_name, &timeout, &deadline))
+        return NULL;
+
+    if ((output = get_output(output_name)) < 0)
+        return NULL;
+
+    /* the time limit is for the whole batch */
+    if (get_deadline(timeout, deadline, &d) < 0)
+        return NULL;
+
+    /* each query is a zero terminated list of assumptions in the stream */
+    if ((stream = get_stream(queries, &n)) == NULL)
+        return NULL;
+    for (p = stream; p < stream + n; p++)
+        if (*p == 0)
+            nq++;
+
+    codes = PyMem_Malloc(nq + 1);
+    if (with_models) {
+        offsets = PyMem_Malloc((nq + 1) * sizeof(Py_ssize_t));
+        max_idx = PyMem_Malloc((nq + 1) * sizeof(int));
+    }
+    if (codes == NULL || (with_models && (offsets == NULL ||
+                                          max_idx == NULL))) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    /* all queries are checked before the first one is solved */
+    if (solver_check_assumptions(self, stream, n) < 0)
+        goto done;
+
+    self->deadline = d;
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS      /* release GIL */
+    p = stream;
+    for (q = 0; q < nq && !nomem; q++) {
+        if (deadline_passed(&self->deadline)) {
+            codes[q] = -1;
+            continue;
         }
-        /* add inverse solution to the clauses, for next iteration */
-        if (blocksol(it->picosat, it->mem) < 0)
-            return NULL;
-        break;
+        for (end = p; *end; end++)
+            picosat_assume(picosat, *end);
+        p = end + 1;
 
-    case PICOSAT_UNSATISFIABLE:
-    case PICOSAT_UNKNOWN:
-        /* no more solutions -- stop iteration */
-        break;
+        if (self->prop_limit)
+            picosat_set_propagation_limit(picosat,
+                                          picosat_propagations(picosat) +
+                                          self->prop_limit);
+        res = picosat_sat(picosat, -1);
+        codes[q] = (res == PICOSAT_SATISFIABLE ? 1 :
+                    res == PICOSAT_UNSATISFIABLE ? 0 : -1);
 
-    default:
-        PyErr_Format(PyExc_SystemError, "picosat return value: %d", res);
+        if (with_models && res == PICOSAT_SATISFIABLE) {
+            max_idx[q] = picosat_variables(picosat);
+            if (used + max_idx[q] + 1 > size) {
+                signed char *tmp;
+
+                size = 2 * (used + max_idx[q] + 1);
+                tmp = PyMem_RawRealloc(vals, size);
+                if (tmp == NULL) {
+                    nomem = 1;
+                    break;
+                }
+                vals = tmp;
+            }
+            offsets[q] = used;
+            get_values(picosat, vals + used, max_idx[q]);
+            solver_hide_aux(self, vals + used, max_idx[q]);
+            used += max_idx[q] + 1;
+        }
     }
-    return result;
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+
+    self->res = res;
+    if (nomem) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    results = new_array("b", codes, nq);
+    if (results == NULL || !with_models)
+        goto done;
+
+    if ((models = PyList_New(nq)) == NULL)
+        goto error;
+    for (q = 0; q < nq; q++) {
+        if (codes[q] == 1) {
+            item = new_solution(vals + offsets[q], max_idx[q], output);
+            if (item == NULL)
+                goto error;
+        }
+        else {
+            Py_INCREF(Py_None);
+            item = Py_None;
+        }
+        PyList_SET_ITEM(models, q, item);
+    }
+    item = PyTuple_Pack(2, results, models);
+    Py_DECREF(results);
+    Py_DECREF(models);
+    results = item;
+    goto done;
+
+error:
+    Py_CLEAR(results);
+    Py_XDECREF(models);
+done:
+    PyMem_RawFree(stream);
+    PyMem_RawFree(vals);
+    PyMem_Free(codes);
+    PyMem_Free(offsets);
+    PyMem_Free(max_idx);
+    return results;
 }
 
-static void soliter_dealloc(soliterobject *it)
+PyDoc_STRVAR(solver_solve_batch_doc,
+"solve_batch(queries [, models, output]) -> array('b')\n\
+\n\
+Solve the problem under each list of assumptions in queries (an iterable\n\
+of iterables of literals, or a buffer of zero terminated lists), one after\n\
+another without acquiring the GIL in between.  Return an array with one\n\
+item per query: 1 for satisfiable, 0 for unsatisfiable, -1 for unknown.\n\
+When models is true, return a tuple (results, models), where models is a\n\
+list holding a solution (in the given output format) for each satisfiable\n\
+query and None otherwise.  The timeout and deadline apply to the whole\n\
+batch, queries after reaching the time limit are unknown.");
+
+static PyObject* solver_failed_assumptions(solverobject *self)
 {
-    PyObject_GC_UnTrack(it);
-    if (it->mem)
-        PyMem_Free(it->mem);
-    picosat_reset(it->picosat);
-    PyObject_GC_Del(it);
+    PyObject *list;
+    const int *lits;
+    Py_ssize_t n = 0, i;
+
+    if (solver_in_use(self) < 0)
+        return NULL;
+    if (self->res != PICOSAT_UNSATISFIABLE) {
+        PyErr_SetString(PyExc_RuntimeError, "no unsatisfiable result");
+        return NULL;
+    }
+    lits = picosat_failed_assumptions(self->picosat);
+    while (lits[n])
+        n++;
+
+    list = PyList_New(n);
+    if (list == NULL)
+        return NULL;
+    for (i = 0; i < n; i++) {
+        PyObject *v = PyInt_FromLong((long) lits[i]);
+        if (v == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, v);
+    }
+    return list;
 }
 
-static int soliter_traverse(soliterobject *it, visitproc visit, void *arg)
+PyDoc_STRVAR(solver_failed_assumptions_doc,
+"failed_assumptions() -> list\n\
+\n\
+Return the assumptions of the last call to solve(), which were used to\n\
+show that the problem is unsatisfiable under these assumptions.  The\n\
+list is empty when the clauses are unsatisfiable by themselves.");
+
+static PyObject* solver_value(solverobject *self, PyObject *arg)
 {
-    return 0;
+    int lit;
+
+    if (get_lit(arg, &lit) < 0 || solver_in_use(self) < 0)
+        return NULL;
+    if (self->res != PICOSAT_SATISFIABLE) {
+        PyErr_SetString(PyExc_RuntimeError, "no solution available");
+        return NULL;
+    }
+    switch (picosat_deref(self->picosat, lit)) {
+    case 1:
+        Py_RETURN_TRUE;
+    case -1:
+        Py_RETURN_FALSE;
+    default:
+        Py_RETURN_NONE;
+    }
 }
 
-static PyTypeObject SolIter_Type = {
+PyDoc_STRVAR(solver_value_doc,
+"value(lit) -> bool or None\n\
+\n\
+Return the value of the literal in the solution found by the last call\n\
+to solve(), or None if the literal is not assigned.");
+
+static PyMethodDef solver_methods[] = {
+    {"add_clause",  (PyCFunction) solver_add_clause,  METH_O,
+      solver_add_clause_doc},
+    {"add_clauses", (PyCFunction) solver_add_clauses, METH_O,
+      solver_add_clauses_doc},
+    {"add_xor",     (PyCFunction) solver_add_xor,     METH_VARARGS |
+                                                      METH_KEYWORDS,
+      solver_add_xor_doc},
+    {"add_atmost",  (PyCFunction) solver_add_atmost,  METH_VARARGS |
+                                                      METH_KEYWORDS,
+      solver_add_atmost_doc},
+    {"add_atleast", (PyCFunction) solver_add_atleast, METH_VARARGS |
+                                                      METH_KEYWORDS,
+      solver_add_atleast_doc},
+    {"add_exactly", (PyCFunction) solver_add_exactly, METH_VARARGS |
+                                                      METH_KEYWORDS,
+      solver_add_exactly_doc},
+    {"add_pb",      (PyCFunction) solver_add_pb,      METH_VARARGS |
+                                                      METH_KEYWORDS,
+      solver_add_pb_doc},
+    {"totalizer",   (PyCFunction) solver_totalizer,   METH_VARARGS |
+                                                      METH_KEYWORDS,
+      solver_totalizer_doc},
+    {"load_dimacs", (PyCFunction) solver_load_dimacs, METH_O,
+      solver_load_dimacs_doc},
+    {"solve",       (PyCFunction) solver_solve,       METH_VARARGS |
+                                                      METH_KEYWORDS,
+      solver_solve_doc},
+    {"solve_batch", (PyCFunction) solver_solve_batch, METH_VARARGS |
+                                                      METH_KEYWORDS,
+      solver_solve_batch_doc},
+    {"value",       (PyCFunction) solver_value,       METH_O,
+      solver_value_doc},
+    {"failed_assumptions", (PyCFunction) solver_failed_assumptions,
+                                                      METH_NOARGS,
+      solver_failed_assumptions_doc},
+    {NULL,          NULL}  /* sentinel */
+};
+
+PyDoc_STRVAR(solver_doc,
+"Solver([clauses [, kwargs]]) -> Solver\n\
+\n\
+Incremental SAT solver, which keeps a single picosat instance (and\n\
+everything it learned) alive across calls to solve().\n\
+Please see " PYCOSAT_URL " for more details.");
+
+static PyTypeObject Solver_Type = {
 #ifdef IS_PY3K
     PyVarObject_HEAD_INIT(NULL, 0)
 #else
     PyObject_HEAD_INIT(NULL)
     0,                                        /* ob_size */
 #endif
-    "soliterator",                            /* tp_name */
-    sizeof(soliterobject),                    /* tp_basicsize */
+    "pycosat.Solver",                         /* tp_name */
+    sizeof(solverobject),                     /* tp_basicsize */
     0,                                        /* tp_itemsize */
     /* methods */
-    (destructor) soliter_dealloc,             /* tp_dealloc */
+    (destructor) solver_dealloc,              /* tp_dealloc */
     0,                                        /* tp_print */
     0,                                        /* tp_getattr */
     0,                                        /* tp_setattr */
@@ -362,15 +5684,25 @@ static PyTypeObject SolIter_Type = {
     PyObject_GenericGetAttr,                  /* tp_getattro */
     0,                                        /* tp_setattro */
     0,                                        /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,  /* tp_flags */
-    0,                                        /* tp_doc */
-    (traverseproc) soliter_traverse,          /* tp_traverse */
+    Py_TPFLAGS_DEFAULT,                       /* tp_flags */
+    solver_doc,                               /* tp_doc */
+    0,                                        /* tp_traverse */
     0,                                        /* tp_clear */
     0,                                        /* tp_richcompare */
     0,                                        /* tp_weaklistoffset */
-    PyObject_SelfIter,                        /* tp_iter */
-    (iternextfunc) soliter_next,              /* tp_iternext */
-    0,                                        /* tp_methods */
+    0,                                        /* tp_iter */
+    0,                                        /* tp_iternext */
+    solver_methods,                           /* tp_methods */
+    0,                                        /* tp_members */
+    0,                                        /* tp_getset */
+    0,                                        /* tp_base */
+    0,                                        /* tp_dict */
+    0,                                        /* tp_descr_get */
+    0,                                        /* tp_descr_set */
+    0,                                        /* tp_dictoffset */
+    0,                                        /* tp_init */
+    0,                                        /* tp_alloc */
+    solver_new,                               /* tp_new */
 };
 
 /*************************** Method definitions *************************/
@@ -381,13 +5713,27 @@ static PyMethodDef module_functions[] = {
       solve_doc},
     {"itersolve", (PyCFunction) itersolve, METH_VARARGS | METH_KEYWORDS,
       itersolve_doc},
+    {"solve_file", (PyCFunction) solve_file, METH_VARARGS | METH_KEYWORDS,
+      solve_file_doc},
+    {"enumerate_to", (PyCFunction) enumerate_to,
+      METH_VARARGS | METH_KEYWORDS, enumerate_to_doc},
+    {"count",     (PyCFunction) count,     METH_VARARGS | METH_KEYWORDS,
+      count_doc},
+    {"sample",    (PyCFunction) sample,    METH_VARARGS | METH_KEYWORDS,
+      sample_doc},
+    {"minimize",  (PyCFunction) minimize,  METH_VARARGS | METH_KEYWORDS,
+      minimize_doc},
+    {"minimize_lex", (PyCFunction) minimize_lex,
+      METH_VARARGS | METH_KEYWORDS, minimize_lex_doc},
     {NULL,        NULL}  /* sentinel */
 };
 
 PyDoc_STRVAR(module_doc, "\
 pycosat: bindings to PicoSAT\n\
 ============================\n\n\
-There are two functions in this module, solve and itersolve.\n\
+There are eight functions in this module, solve, itersolve, solve_file,\n\
+enumerate_to, count, sample, minimize and minimize_lex, and the\n\
+incremental Solver type.\n\
 Please see " PYCOSAT_URL " for more details.");
 
 /* initialization routine for the shared library */
@@ -405,17 +5751,28 @@ PyMODINIT_FUNC initpycosat(void)
 #ifdef IS_PY3K
     if (PyType_Ready(&SolIter_Type) < 0)
         return NULL;
+    if (PyType_Ready(&Solver_Type) < 0)
+        return NULL;
+    if (PyType_Ready(&Totalizer_Type) < 0)
+        return NULL;
     m = PyModule_Create(&moduledef);
     if (m == NULL)
         return NULL;
 #else
     if (PyType_Ready(&SolIter_Type) < 0)
         return;
+    if (PyType_Ready(&Solver_Type) < 0)
+        return;
+    if (PyType_Ready(&Totalizer_Type) < 0)
+        return;
     m = Py_InitModule3("pycosat", module_functions, module_doc);
     if (m == NULL)
         return;
 #endif
 
+    Py_INCREF(&Solver_Type);
+    PyModule_AddObject(m, "Solver", (PyObject *) &Solver_Type);
+
     PyModule_AddObject(m, "__version__",
                        PyUnicode_FromString(PYCOSAT_VERSION));
 
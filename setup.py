@@ -1,6 +1,8 @@
 import re
 import sys
 from distutils.core import setup, Extension
+from distutils.ccompiler import new_compiler
+from distutils.sysconfig import customize_compiler
 
 
 # Read version from pycosat.c
@@ -9,12 +11,27 @@ data = open("pycosat.c").read()
 version = pat.search(data).group(1)
 
 
-ext_kwds = dict(name="pycosat", sources=["pycosat.c"], define_macros=[])
+ext_kwds = dict(name="pycosat", sources=["pycosat.c"], define_macros=[],
+                libraries=[])
+
+# Reading gzip compressed DIMACS files requires zlib
+def have_zlib():
+    compiler = new_compiler()
+    customize_compiler(compiler)
+    try:
+        return compiler.has_function("zlibVersion", includes=["zlib.h"],
+                                     libraries=["z"])
+    except Exception:
+        return False
+
+if have_zlib():
+    ext_kwds["define_macros"].append(("WITH_ZLIB", 1))
+    ext_kwds["libraries"].append("z")
 
 if "--inplace" in sys.argv:
     ext_kwds["define_macros"].append(("DONT_INCLUDE_PICOSAT", 1))
     ext_kwds["library_dirs"] = ["."]
-    ext_kwds["libraries"] = ["picosat"]
+    ext_kwds["libraries"].insert(0, "picosat")
 
 
 setup(
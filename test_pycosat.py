@@ -1,6 +1,14 @@
+import os
 import sys
 import copy
+import time
+import gzip
+import shutil
+import tempfile
 import random
+import itertools
+import threading
+from array import array
 from os.path import basename
 import unittest
 
@@ -158,10 +166,166 @@ class TestSolve(unittest.TestCase):
         self.assertEqual(solve(clauses1, vars=7),
                          [1, -2, -3, -4, 5, -6, -7])
 
+    def test_output(self):
+        self.assertEqual(solve(clauses1, output='list'), [1, -2, -3, -4, 5])
+        self.assertEqual(solve(clauses1, output=None), [1, -2, -3, -4, 5])
+        self.assertEqual(solve(clauses1, output='array'),
+                         array('i', [1, -2, -3, -4, 5]))
+        self.assertEqual(solve(clauses1, output='positive'), [1, 5])
+        self.assertEqual(solve(clauses1, output='bitset'), b'\x11')
+        self.assertEqual(solve(clauses1, vars=9, output='bitset'),
+                         b'\x11\x00')
+        self.assertEqual(solve([[i] for i in range(1, 11)],
+                               output='bitset'), b'\xff\x03')
+        self.assertEqual(solve([[-i, 10] for i in range(1, 10)] + [[1]],
+                               output='bitset'), b'\x01\x02')
+        self.assertEqual(solve(clauses2, output='bitset'), "UNSAT")
+        self.assertEqual(solve([], output='array'), array('i'))
+        self.assertEqual(solve([], output='bitset'), b'')
+        self.assertRaises(ValueError, solve, clauses1, output='tuple')
+        self.assertRaises(TypeError, solve, clauses1, output=1)
+
+    def test_portfolio(self):
+        for n in 2, 5:
+            for clauses in clauses1, clauses2, clauses3:
+                res = solve(clauses, portfolio=n)
+                if res == "UNSAT":
+                    self.assertEqual(solve(clauses), "UNSAT")
+                else:
+                    self.assertTrue(evaluate(clauses, res))
+            self.assertEqual(solve([[1], [-1]], portfolio=n), "UNSAT")
+            self.assertEqual(solve([], portfolio=n), [])
+        self.assertEqual(solve(array('i', flat_lits(clauses1)),
+                               portfolio=3, output='bitset')[0] & 0xe0, 0)
+        self.assertEqual(solve(clauses1, portfolio=3, prop_limit=2),
+                         "UNKNOWN")
+        self.assertRaises(ValueError, solve, clauses1, portfolio=0)
+        self.assertRaises(ValueError, solve, clauses1, portfolio=65)
+        self.assertRaises(ValueError, solve, clauses1, portfolio=10 ** 6)
+        self.assertRaises(ValueError, solve, [[1, 0]], portfolio=2)
+        self.assertRaises(TypeError, solve, [[1, 'a']], portfolio=2)
+
+    def test_portfolio_random(self):
+        random.seed(42)
+        for _ in range(20):
+            clauses = [[random.choice([-1, 1]) * random.randint(1, 30)
+                        for _ in range(3)] for _ in range(120)]
+            res = solve(clauses, portfolio=4)
+            if res == "UNSAT":
+                self.assertEqual(solve(clauses), "UNSAT")
+            else:
+                self.assertTrue(evaluate(clauses, res))
+
+    def test_portfolio_share(self):
+        random.seed(43)
+        for _ in range(20):
+            nvars = random.randint(20, 60)
+            clauses = [[random.choice([-1, 1]) * random.randint(1, nvars)
+                        for _ in range(3)] for _ in range(int(4.3 * nvars))]
+            res = solve(clauses, portfolio=3, share=True)
+            if res == "UNSAT":
+                self.assertEqual(solve(clauses), "UNSAT")
+            else:
+                self.assertTrue(evaluate(clauses, res))
+        self.assertEqual(solve(clauses1, share=True),
+                         solve(clauses1))
+
 tests.append(TestSolve)
 
 # -----
 
+def flat_lits(clauses):
+    "return the clauses as a flat, zero terminated stream of literals"
+    res = []
+    for clause in clauses:
+        res.extend(clause)
+        res.append(0)
+    return res
+
+class TestBuffer(unittest.TestCase):
+
+    def test_array(self):
+        for tc in 'hilq':
+            lits = array(tc, flat_lits(clauses1))
+            self.assertEqual(solve(lits), [1, -2, -3, -4, 5])
+        self.assertEqual(solve(array('i', flat_lits(clauses2))), "UNSAT")
+        self.assertEqual(solve(array('i', flat_lits(clauses3)), vars=3),
+                         [-1, -2, -3])
+
+    def test_memoryview_bytes(self):
+        lits = array('i', flat_lits(clauses1))
+        self.assertEqual(solve(memoryview(lits)), [1, -2, -3, -4, 5])
+        self.assertEqual(solve(lits.tobytes()), [1, -2, -3, -4, 5])
+        self.assertEqual(solve(bytearray(lits.tobytes())),
+                         [1, -2, -3, -4, 5])
+
+    def test_empty(self):
+        self.assertEqual(solve(array('i'), vars=2), [-1, -2])
+
+    def test_itersolve(self):
+        lits = array('q', flat_lits(clauses1))
+        self.assertEqual(sorted(itersolve(lits, nvars1)),
+                         sorted(itersolve(clauses1, nvars1)))
+
+    def test_solver(self):
+        s = pycosat.Solver(array('i', flat_lits(clauses1)))
+        self.assertEqual(s.solve(), [1, -2, -3, -4, 5])
+        s.add_clauses(array('l', [-1, 0]))
+        self.assertTrue(evaluate(clauses1 + [[-1]], s.solve()))
+
+    def test_random_cnfs(self):
+        # includes repeated literals, tautologies and unit clauses
+        rnd = random.Random(42)
+        for _ in range(50):
+            n = rnd.randint(1, 8)
+            cnf = [[rnd.choice([-1, 1]) * rnd.randint(1, n)
+                    for _ in range(rnd.randint(1, 4))]
+                   for _ in range(rnd.randint(0, 20))]
+            lits = array('i', flat_lits(cnf))
+            self.assertEqual(solve(lits, vars=n), solve(cnf, vars=n))
+            self.assertEqual(sorted(itersolve(lits, vars=n)),
+                             sorted(itersolve(cnf, vars=n)))
+
+    def test_wrong_buffers(self):
+        self.assertRaises(TypeError, solve, array('d', [1.0, 0.0]))
+        self.assertRaises(TypeError, solve, array('I', [1, 0]))
+        self.assertRaises(TypeError, solve, b'\x01\x00\x00')
+        # typed buffers of single bytes are not raw native ints
+        self.assertRaises(TypeError, solve,
+                          array('b', [1, 0, 0, 0, 0, 0, 0, 0]))
+        self.assertRaises(TypeError, solve, array('B', [1, 0, 0, 0]))
+        self.assertRaises(TypeError, solve, memoryview(b'\x01\x00\x00\x00'))
+        self.assertRaises(ValueError, solve, array('i', [1, 2]))
+        self.assertRaises(ValueError, solve, array('i', [1, 0, 2]))
+        self.assertRaises(OverflowError, solve, array('q', [2 ** 40, 0]))
+        self.assertRaises(OverflowError, solve, array('i', [-2 ** 31, 0]))
+        s = pycosat.Solver()
+        self.assertRaises(ValueError, s.add_clauses, array('i', [1, 0, 2]))
+        # nothing was added by the bad stream above
+        s.add_clauses(array('i', [-1, 0]))
+        self.assertEqual(s.solve(), [-1])
+
+tests.append(TestBuffer)
+
+# -----
+
+def queens(n):
+    # the n-queens problem, one variable for each square of the board
+    v = lambda i, j: n * i + j + 1
+    clauses = []
+    for lines in ([[v(i, j) for j in range(n)] for i in range(n)],
+                  [[v(i, j) for i in range(n)] for j in range(n)]):
+        for line in lines:
+            clauses.append(line)
+            clauses.extend([-a, -b] for a in line for b in line if a < b)
+    for i in range(n):
+        for j in range(n):
+            for k in range(1, n - i):
+                for l in j - k, j + k:
+                    if 0 <= l < n:
+                        clauses.append([-v(i, j), -v(i + k, l)])
+    return clauses
+
 class TestIterSolve(unittest.TestCase):
 
     def test_wrong_args(self):
@@ -246,8 +410,1063 @@ class TestIterSolve(unittest.TestCase):
     def test_cnf1_prop_limit(self):
         self.assertEqual(list(itersolve(clauses1, prop_limit=2)), [])
 
+    def test_output(self):
+        sols = list(itersolve(clauses1))
+        self.assertEqual(list(itersolve(clauses1, output='array')),
+                         [array('i', sol) for sol in sols])
+        self.assertEqual(list(itersolve(clauses1, output='positive')),
+                         [[x for x in sol if x > 0] for sol in sols])
+        bitsets = list(itersolve(clauses1, output='bitset'))
+        self.assertEqual(bitsets,
+                         [bytes(bytearray([sum(1 << (x - 1)
+                                               for x in sol if x > 0)]))
+                          for sol in sols])
+        self.assertRaises(ValueError, itersolve, clauses1, output='tuple')
+
+    def test_project(self):
+        random.seed(11)
+        rclauses = [[random.choice([-1, 1]) * random.randint(1, 12)
+                     for _ in range(3)] for _ in range(30)]
+        for clauses, nvars in (clauses1, nvars1), (rclauses, 12):
+            for project in [1], [2, 5], [-3, 1, 4, 3], list(range(1, 6)):
+                vs = sorted(set(abs(v) for v in project))
+                expected = set(tuple(sol[v - 1] for v in vs)
+                               for sol in itersolve(clauses, nvars))
+                sols = [tuple(sol) for sol in
+                        itersolve(clauses, nvars, project=project)]
+                self.assertEqual(len(sols), len(expected))
+                self.assertEqual(set(sols), expected)
+
+    def test_project_output(self):
+        self.assertEqual(sorted(itersolve(clauses1, project=[1, 2])),
+                         [[-1, -2], [-1, 2], [1, -2], [1, 2]])
+        self.assertEqual(sorted(itersolve(clauses1, project=[5],
+                                          output='positive')), [[], [5]])
+        self.assertEqual(sorted(itersolve(clauses1, project=(4, 5),
+                                          output='bitset')),
+                         [b'\x00', b'\x08', b'\x10', b'\x18'])
+        self.assertEqual(sorted(a.tolist() for a in
+                                itersolve(clauses1, project=[4, 3],
+                                          output='array')),
+                         [[-3, -4], [-3, 4], [3, -4]])
+        # variables not in any clause are free
+        self.assertEqual(len(list(itersolve(clauses1, project=[7, 8]))), 4)
+        self.assertEqual(list(itersolve(clauses1, project=[])), [[]])
+        self.assertEqual(list(itersolve([[1], [-1]], project=[1])), [])
+        self.assertRaises(TypeError, itersolve, clauses1, project=[1.0])
+        self.assertRaises(ValueError, itersolve, clauses1, project=[0])
+
+    def test_blocking(self):
+        random.seed(12)
+        rclauses = [[random.choice([-1, 1]) * random.randint(1, 14)
+                     for _ in range(3)] for _ in range(30)]
+        for clauses, nvars in (clauses1, nvars1), (rclauses, 14):
+            for project in None, [2, 5], list(range(1, 10)):
+                full = [tuple(sol) for sol in itersolve(
+                    clauses, nvars, project=project, blocking='full')]
+                sols = [tuple(sol) for sol in itersolve(
+                    clauses, nvars, project=project, blocking='decisions')]
+                self.assertEqual(len(sols), len(full))
+                self.assertEqual(set(sols), set(full))
+        self.assertRaises(ValueError, itersolve, clauses1, blocking='all')
+
+    def test_cubes(self):
+        random.seed(14)
+        rclauses = [[random.choice([-1, 1]) * random.randint(1, 12)
+                     for _ in range(3)] for _ in range(25)]
+        for clauses, nvars in (clauses1, nvars1), (rclauses, 12):
+            for project in None, [2, 5, 6], list(range(1, 8)):
+                vs = project or list(range(1, nvars + 1))
+                expected = set(tuple(sol) for sol in
+                               itersolve(clauses, nvars, project=project))
+                sols = []
+                cubes = list(itersolve(clauses, nvars, project=project,
+                                       cubes=True))
+                self.assertTrue(len(cubes) <= len(expected))
+                for cube in cubes:
+                    free = [v for v in vs if v not in map(abs, cube)]
+                    for signs in itertools.product([-1, 1],
+                                                   repeat=len(free)):
+                        sol = cube + [s * v for s, v in zip(signs, free)]
+                        sols.append(tuple(sorted(sol, key=abs)))
+                self.assertEqual(len(sols), len(expected))
+                self.assertEqual(set(sols), expected)
+
+    def test_cubes_args(self):
+        self.assertEqual(list(itersolve([[1, 2]], 3, cubes=True,
+                                        output='array'))[0].typecode, 'i')
+        self.assertEqual(list(itersolve([], 3, cubes=True)), [[]])
+        self.assertEqual(list(itersolve([[1], [-1]], cubes=True)), [])
+        for output in 'bitset', 'positive':
+            self.assertRaises(ValueError, itersolve, clauses1,
+                              cubes=True, output=output)
+        self.assertRaises(ValueError, itersolve, clauses1, cubes=True,
+                          blocking='decisions')
+
+    def test_batch(self):
+        sols = list(itersolve(clauses1))
+        for batch in 1, 5, 18, 100:
+            chunks = list(itersolve(clauses1, batch=batch))
+            self.assertEqual([len(c) for c in chunks[:-1]],
+                             [batch] * (len(chunks) - 1))
+            self.assertEqual([sol for c in chunks for sol in c], sols)
+        if sys.version_info[0] >= 3:
+            chunks = list(itersolve(clauses1, batch=4, output='array'))
+            self.assertEqual(chunks[0].shape, (4, 5))
+            self.assertEqual(chunks[-1].shape, (2, 5))
+            self.assertEqual([sol for c in chunks for sol in c.tolist()],
+                             sols)
+            chunks = list(itersolve(clauses1, batch=4, output='bitset'))
+            self.assertEqual(chunks[0].shape, (4, 1))
+            self.assertEqual(
+                [bytes(bytearray(row)) for c in chunks for row in c.tolist()],
+                list(itersolve(clauses1, output='bitset')))
+            chunks = list(itersolve(clauses1, batch=3, project=[4, 1],
+                                    output='array'))
+            self.assertEqual([sol for c in chunks for sol in c.tolist()],
+                             list(itersolve(clauses1, project=[1, 4])))
+        self.assertEqual(list(itersolve([[1], [-1]], batch=10)), [])
+        self.assertRaises(ValueError, itersolve, clauses1, batch=-1)
+
+    def test_queens(self):
+        clauses = queens(8)
+        for blocking in 'decisions', 'full':
+            sols = [tuple(sol) for sol in itersolve(clauses,
+                                                    blocking=blocking)]
+            self.assertEqual(len(sols), 92)
+            self.assertEqual(len(set(sols)), 92)
+
 tests.append(TestIterSolve)
 
+# -----
+
+class TestSolver(unittest.TestCase):
+
+    def test_wrong_args(self):
+        self.assertRaises(TypeError, pycosat.Solver, 1)
+        self.assertRaises(TypeError, pycosat.Solver, [[1, 2], [-3]], 'A')
+        s = pycosat.Solver()
+        self.assertRaises(TypeError, s.add_clause, 1)
+        self.assertRaises(TypeError, s.add_clause, ['a'])
+        self.assertRaises(ValueError, s.add_clause, [1, 0])
+        self.assertRaises(OverflowError, s.add_clause, [1, 2 ** 40])
+        self.assertRaises(TypeError, s.add_clauses, [[1, 2], [3, None]])
+        self.assertRaises(TypeError, s.value, 'a')
+        self.assertRaises(ValueError, s.value, 0)
+
+    def test_bad_clause_not_added(self):
+        s = pycosat.Solver()
+        self.assertRaises(TypeError, s.add_clause, [1, 2, None])
+        # the literals before the bad one must not leave an incomplete
+        # clause behind
+        s.add_clause([-1])
+        self.assertEqual(s.solve(), [-1])
+
+    def test_cnf1(self):
+        s = pycosat.Solver(clauses1)
+        self.assertEqual(s.solve(), [1, -2, -3, -4, 5])
+        self.assertEqual(s.solve(), [1, -2, -3, -4, 5])
+
+    def test_incremental(self):
+        s = pycosat.Solver()
+        for clause in clauses1:
+            s.add_clause(clause)
+        sol = s.solve()
+        self.assertTrue(evaluate(clauses1, sol))
+        s.add_clauses([[-1], [-5]])
+        sol = s.solve()
+        self.assertTrue(evaluate(clauses1 + [[-1], [-5]], sol))
+        s.add_clause([1])
+        self.assertEqual(s.solve(), "UNSAT")
+        self.assertEqual(s.solve(), "UNSAT")
+
+    def test_matches_itersolve(self):
+        # enumerating through a Solver finds the same solutions
+        s = pycosat.Solver(clauses1, vars=nvars1)
+        sols = set()
+        while True:
+            sol = s.solve()
+            if not isinstance(sol, list):
+                break
+            sols.add(tuple(sol))
+            s.add_clause([-x for x in sol])
+        self.assertEqual(sols, set(tuple(sol) for sol in
+                                   itersolve(clauses1, nvars1)))
+
+    def test_value(self):
+        s = pycosat.Solver(clauses3, vars=3)
+        self.assertRaises(RuntimeError, s.value, 1)
+        self.assertEqual(s.solve(), [-1, -2, -3])
+        self.assertEqual(s.value(1), False)
+        self.assertEqual(s.value(-1), True)
+        self.assertEqual(s.value(7), None)
+        s.add_clause([3])
+        # adding a clause invalidates the previous solution
+        self.assertRaises(RuntimeError, s.value, 3)
+        s.solve()
+        self.assertEqual(s.value(3), True)
+        s.add_clause([1])
+        self.assertEqual(s.solve(), "UNSAT")
+        self.assertRaises(RuntimeError, s.value, 1)
+
+    def test_output(self):
+        s = pycosat.Solver(clauses1)
+        self.assertEqual(s.solve(output='positive'), [1, 5])
+        self.assertEqual(s.solve(output='array'),
+                         array('i', [1, -2, -3, -4, 5]))
+        self.assertEqual(s.solve(output='bitset'), b'\x11')
+        self.assertEqual(s.value(5), True)
+        self.assertRaises(ValueError, s.solve, output='tuple')
+
+    def test_prop_limit(self):
+        s = pycosat.Solver(clauses1, prop_limit=2)
+        self.assertEqual(s.solve(), "UNKNOWN")
+        self.assertEqual(pycosat.Solver(clauses1, prop_limit=8).solve(),
+                         [1, -2, -3, -4, 5])
+
+    def test_assumptions(self):
+        s = pycosat.Solver(clauses1)
+        for assumptions in [-1], [-1, 4], [2, -5, 4], []:
+            sol = s.solve(assumptions=assumptions)
+            self.assertTrue(evaluate(clauses1, sol))
+            for lit in assumptions:
+                self.assertTrue(s.value(lit))
+        self.assertEqual(s.solve(assumptions=[3, 2, 4]), "UNSAT")
+        self.assertEqual(sorted(s.failed_assumptions()), [3, 4])
+        self.assertEqual(s.solve(assumptions=(x for x in [-4, -3, -5, 1])),
+                         "UNSAT")
+        self.assertEqual(sorted(s.failed_assumptions()), [-5, -4, -3, 1])
+        # assumptions only apply to a single call
+        self.assertTrue(evaluate(clauses1, s.solve()))
+        self.assertRaises(RuntimeError, s.failed_assumptions)
+        # assumptions on unknown variables do not add them to solutions
+        self.assertRaises(ValueError, s.solve, assumptions=[1, -100])
+        self.assertEqual(len(s.solve()), 5)
+        self.assertEqual(len(s.solve(output='bitset')), 1)
+        s.add_clause([-5])
+        self.assertEqual(s.solve(assumptions=[-4, -3, 1]), "UNSAT")
+        self.assertEqual(sorted(s.failed_assumptions()), [-4, -3, 1])
+        s.add_clause([5])
+        self.assertEqual(s.solve(assumptions=[1]), "UNSAT")
+        self.assertEqual(s.failed_assumptions(), [])
+
+    def test_wrong_assumptions(self):
+        s = pycosat.Solver(clauses1)
+        self.assertRaises(TypeError, s.solve, assumptions=1)
+        self.assertRaises(ValueError, s.solve,
+                          assumptions=[-3, -4, -5, 1, 0])
+        self.assertRaises(TypeError, s.solve,
+                          assumptions=[-3, -4, -5, 1, 'a'])
+        # nothing was assumed by the failed calls
+        self.assertTrue(evaluate(clauses1, s.solve()))
+
+    def test_solve_batch(self):
+        s = pycosat.Solver(clauses1)
+        queries = [[3, 2, 4], [-1], [], [-4, -3, -5, 1], [-1, 4]]
+        results = s.solve_batch(queries)
+        self.assertEqual(results, array('b', [0, 1, 1, 0, 1]))
+        # the solver is left in the state of the last query
+        self.assertEqual(s.value(4), True)
+        results, models = s.solve_batch(queries, models=True)
+        self.assertEqual(list(results), [0, 1, 1, 0, 1])
+        for query, model in zip(queries, models):
+            if model is None:
+                self.assertEqual(s.solve(assumptions=query), "UNSAT")
+                continue
+            self.assertTrue(evaluate(clauses1, model))
+            for lit in query:
+                self.assertTrue(lit in model)
+        self.assertEqual(s.solve_batch([[-5, 1, -3, -4]]), array('b', [0]))
+        self.assertEqual(sorted(s.failed_assumptions()), [-5, -4, -3, 1])
+        # queries as a buffer of zero terminated assumption lists
+        self.assertEqual(s.solve_batch(array('i', [-1, 0, 3, 4, 0, 0])),
+                         array('b', [1, 0, 1]))
+        results, models = s.solve_batch(array('q', [5, 0]), models=True,
+                                        output='positive')
+        self.assertEqual(models[0][-1], 5)
+        self.assertRaises(ValueError, s.solve_batch, [[1], [-100]])
+        self.assertEqual(len(s.solve_batch([[1]], models=True)[1][0]), 5)
+        self.assertEqual(s.solve_batch([]), array('b'))
+        self.assertRaises(ValueError, s.solve_batch, [[1, 0]])
+        self.assertRaises(ValueError, s.solve_batch, array('i', [1]))
+        self.assertRaises(TypeError, s.solve_batch, [1])
+
+    def test_solve_batch_prop_limit(self):
+        s = pycosat.Solver(clauses1, prop_limit=2)
+        self.assertEqual(s.solve_batch([[], [-1]]), array('b', [-1, -1]))
+
+    def models(self, s, n):
+        # all solutions of the solver s on the variables 1, ..., n
+        s.add_clause([n, -n])
+        res = []
+        while True:
+            sol = s.solve()
+            if sol == 'UNSAT':
+                return sorted(res)
+            res.append(sol[:n])
+            s.add_clause([-lit for lit in sol[:n]])
+
+    def test_add_xor(self):
+        s = pycosat.Solver()
+        s.add_xor([1, 2, 3])
+        self.assertEqual(self.models(s, 3), [[-1, -2, 3], [-1, 2, -3],
+                                             [1, -2, -3], [1, 2, 3]])
+        s = pycosat.Solver()
+        s.add_xor([1, -2, 3, 4], rhs=False)
+        for sol in self.models(s, 4):
+            self.assertEqual(sum(lit > 0 for lit in sol) % 2, 1)
+        s = pycosat.Solver()
+        s.add_xor([1, 2, 1, 3, 3])      # duplicates cancel out
+        self.assertEqual(self.models(s, 3), [[-1, 2, -3], [-1, 2, 3],
+                                             [1, 2, -3], [1, 2, 3]])
+        s = pycosat.Solver()
+        s.add_xor([], rhs=False)
+        self.assertEqual(s.solve(), [])
+        s.add_xor([])
+        self.assertEqual(s.solve(), 'UNSAT')
+        self.assertRaises(TypeError, s.add_xor, [1, 'a'])
+
+    def test_xor_long(self):
+        s = pycosat.Solver()
+        s.add_xor(range(1, 41))
+        self.assertEqual(sum(lit > 0 for lit in s.solve()) % 2, 1)
+        sol = s.solve([-i for i in range(2, 41)])
+        self.assertEqual(sol, [1] + [-i for i in range(2, 41)])
+        self.assertEqual(s.solve([-i for i in range(1, 41)]), 'UNSAT')
+
+    def test_xor_system(self):
+        # the sum of the first three is inconsistent with the last one,
+        # which Gaussian elimination detects without search
+        s = pycosat.Solver()
+        s.add_xor([1, 2, 3, 4])
+        s.add_xor([3, 4, 5, 6])
+        s.add_xor([1, 7, 8])
+        self.assertNotEqual(s.solve(), 'UNSAT')
+        s.add_xor([2, 5, 6, 7, 8], rhs=False)
+        self.assertEqual(s.solve(), 'UNSAT')
+
+    def test_xor_random(self):
+        rnd = random.Random(5)
+        for _ in range(30):
+            n = rnd.randint(3, 8)
+            cnf = [[rnd.choice([-1, 1]) * rnd.randint(1, n)
+                    for _ in range(3)] for _ in range(rnd.randint(0, n))]
+            xors = [([rnd.choice([-1, 1]) * v
+                      for v in rnd.sample(range(1, n + 1), rnd.randint(1, n))],
+                     rnd.randint(0, 1)) for _ in range(rnd.randint(1, 3))]
+            s = pycosat.Solver(cnf)
+            for lits, rhs in xors:
+                s.add_xor(lits, rhs)
+            expected = []
+            for sol in itersolve(cnf + [[n, -n]]):
+                if all(sum(sol[abs(lit) - 1] == lit for lit in lits) % 2
+                       == rhs for lits, rhs in xors):
+                    expected.append(sol)
+            self.assertEqual(self.models(s, n), sorted(expected))
+
+    def test_cardinality(self):
+        for n in range(1, 7):
+            for k in range(-1, n + 2):
+                for add, ok in [('add_atmost', lambda c: c <= k),
+                                ('add_atleast', lambda c: c >= k),
+                                ('add_exactly', lambda c: c == k)]:
+                    s = pycosat.Solver(vars=n)
+                    getattr(s, add)(range(1, n + 1), k)
+                    expected = [sol for sol in itersolve([], vars=n)
+                                if ok(sum(lit > 0 for lit in sol))]
+                    self.assertEqual(self.models(s, n), sorted(expected))
+        s = pycosat.Solver()
+        self.assertRaises(TypeError, s.add_atmost, [1, 'a'], 1)
+        self.assertRaises(ValueError, s.add_atleast, [1, 0], 1)
+
+    def test_cardinality_large(self):
+        # native constraints add no auxiliary variables
+        for n, k in [(50, 1), (100, 37), (100, 90), (1000, 100)]:
+            s = pycosat.Solver()
+            s.add_exactly(range(1, n + 1), k)
+            sol = s.solve()
+            self.assertEqual(len(sol), n)
+            self.assertEqual(sum(lit > 0 for lit in sol), k)
+            self.assertEqual(s.solve(range(1, k + 2)), 'UNSAT')
+            self.assertEqual(s.solve(range(-1, -n + k - 2, -1)), 'UNSAT')
+            s.add_clause([n + 1])
+            self.assertEqual(s.solve()[-1], n + 1)
+
+    def test_cardinality_search(self):
+        # one version per package, and dependencies between versions
+        rnd = random.Random(5)
+        npkgs, nvers = 40, 30
+        var = lambda p, v: p * nvers + v + 1
+        s = pycosat.Solver()
+        clauses = []
+        for p in range(npkgs):
+            s.add_atmost([var(p, v) for v in range(nvers)], 1)
+            clauses.append([var(p, v) for v in range(nvers)])
+        for _ in range(npkgs * nvers):
+            p, q = rnd.sample(range(npkgs), 2)
+            clauses.append([-var(p, rnd.randrange(nvers))] +
+                           [var(q, v) for v in rnd.sample(range(nvers), 3)])
+        s.add_clauses(clauses)
+        sol = s.solve()
+        self.assertNotEqual(sol, 'UNSAT')
+        self.assertEqual(sum(lit > 0 for lit in sol), npkgs)
+        self.assertTrue(all(any(lit in sol for lit in clause)
+                            for clause in clauses))
+        # pigeons in fewer holes
+        n = 7
+        var = lambda p, h: p * (n - 1) + h + 1
+        s = pycosat.Solver()
+        for p in range(n):
+            s.add_atleast([var(p, h) for h in range(n - 1)], 1)
+        for h in range(n - 1):
+            s.add_atmost([var(p, h) for p in range(n)], 1)
+        self.assertEqual(s.solve(), 'UNSAT')
+
+    def test_add_pb(self):
+        s = pycosat.Solver()
+        s.add_pb([3, 2, 2, 1], [1, 2, 3, 4], '<=', 3)
+        models = self.models(s, 4)
+        self.assertEqual(len(models), 7)
+        for sol in models:
+            self.assertTrue(sum(c for c, lit in zip([3, 2, 2, 1], sol)
+                                if lit > 0) <= 3)
+        s = pycosat.Solver()
+        s.add_pb([2, -3, 1], [1, -2, 3], '==', -1)
+        self.assertEqual(self.models(s, 3), [[1, -2, -3]])
+        self.assertRaises(ValueError, s.add_pb, [1], [1], '!=', 0)
+        self.assertRaises(ValueError, s.add_pb, [1, 2], [1], '<=', 0)
+        self.assertRaises(OverflowError, s.add_pb, [2 ** 62, 2 ** 62],
+                          [1, 2], '<=', 0)
+
+    def test_pb_random(self):
+        rnd = random.Random(7)
+        ops = {'<=': lambda a, b: a <= b, '<': lambda a, b: a < b,
+               '>=': lambda a, b: a >= b, '>': lambda a, b: a > b,
+               '==': lambda a, b: a == b}
+        for _ in range(60):
+            n = rnd.randint(1, 6)
+            lits = [rnd.choice([-1, 1]) * rnd.randint(1, n)
+                    for _ in range(rnd.randint(1, 8))]
+            coeffs = [rnd.randint(-5, 5) for _ in lits]
+            op = rnd.choice(sorted(ops))
+            rhs = rnd.randint(-8, 8)
+            s = pycosat.Solver(vars=n)
+            s.add_pb(coeffs, lits, op, rhs)
+            expected = [sol for sol in itersolve([], vars=n)
+                        if ops[op](sum(c for c, lit in zip(coeffs, lits)
+                                       if sol[abs(lit) - 1] == lit), rhs)]
+            self.assertEqual(self.models(s, n), sorted(expected))
+
+    def test_pb_large(self):
+        # too large for a BDD, which is replaced by adders
+        rnd = random.Random(3)
+        coeffs = [rnd.randint(1, 1000) for _ in range(200)]
+        rhs = sum(coeffs) // 2
+        s = pycosat.Solver()
+        s.add_pb(coeffs, range(1, 201), '>=', rhs)
+        sol = s.solve()
+        self.assertEqual(len(sol), 200)
+        self.assertTrue(sum(c for c, lit in zip(coeffs, sol) if lit > 0)
+                        >= rhs)
+        # whose auxiliary variables cannot be used by clauses
+        self.assertRaises(ValueError, s.add_clause, [201])
+        self.assertRaises(ValueError, s.add_clauses, [[1], [-201]])
+        s = pycosat.Solver(vars=201)
+        s.add_pb(coeffs, range(1, 201), '>=', rhs)
+        s.add_clause([201])
+        self.assertEqual(s.solve()[-1], 201)
+
+    def test_pb_extreme_rhs(self):
+        s = pycosat.Solver(vars=3)
+        for op in ['<', '<=', '>', '>=', '==']:
+            for rhs in [-2 ** 63, 2 ** 63 - 1]:
+                self.assertRaises(OverflowError, s.add_pb, [1], [1], op, rhs)
+        self.assertRaises(OverflowError, s.add_pb, [1], [1], '<', -2 ** 64)
+        # nothing was added
+        self.assertEqual(s.solve(), [-1, -2, -3])
+        s.add_pb([1], [1], '>', 0)
+        self.assertEqual(s.solve(), [1, -2, -3])
+
+    def test_totalizer(self):
+        s = pycosat.Solver(vars=8)
+        tot = s.totalizer([1, 2, 3, -4])
+        self.assertEqual(len(tot), 4)
+        for k in range(5):
+            sol = s.solve([tot.at_most(k), tot.at_least(k)])
+            self.assertEqual(sum(lit in sol for lit in [1, 2, 3, -4]), k)
+        self.assertEqual(s.solve([tot.at_most(-1)]), 'UNSAT')
+        self.assertEqual(s.solve([tot.at_least(5)]), 'UNSAT')
+        self.assertEqual(s.solve([tot.at_most(2), tot.at_least(3)]), 'UNSAT')
+        self.assertEqual(len(s.solve([tot.at_most(4)])), 8)
+        # the bounds of new inputs include the old ones
+        tot.extend([5, 6, 7, 8])
+        self.assertEqual(len(tot), 8)
+        sol = s.solve([tot.at_least(8)])
+        self.assertEqual(sol, [1, 2, 3, -4, 5, 6, 7, 8])
+        self.assertEqual(s.solve([tot.at_least(8), -5]), 'UNSAT')
+        self.assertEqual(sorted(s.failed_assumptions(), key=abs),
+                         [-5, tot.at_least(8)])
+        # outputs are auxiliary variables
+        self.assertRaises(ValueError, s.add_clause, [abs(tot.at_most(1))])
+        self.assertEqual(len(pycosat.Solver().totalizer()), 0)
+
+    def test_totalizer_improve(self):
+        # solution-improving search, which tightens the bound by an
+        # assumption instead of adding clauses each time
+        clauses = [[1, 2], [2, 3], [3, 4], [-1, -4, 5], [4, 5, 6],
+                   [-2, 6, 7], [1, 7], [-3, -6]]
+        s = pycosat.Solver(clauses)
+        tot = s.totalizer(range(1, 8))
+        sol = s.solve()
+        while sol != 'UNSAT':
+            best = sum(lit > 0 for lit in sol)
+            sol = s.solve([tot.at_most(best - 1)])
+        self.assertEqual(best, pycosat.minimize(
+            clauses, [(1, v) for v in range(1, 8)])[1])
+
+    def test_in_use(self):
+        # picosat is not reentrant, so a Solver is used by one call at a time
+        s = pycosat.Solver(hard_cnf(350))
+        t = threading.Thread(target=s.solve, kwargs={"timeout": 1.0})
+        t.start()
+        try:
+            time.sleep(0.2)
+            self.assertRaises(RuntimeError, s.solve)
+            self.assertRaises(RuntimeError, s.solve_batch, [[1]])
+            self.assertRaises(RuntimeError, s.add_clause, [1, 2])
+            self.assertRaises(RuntimeError, s.add_clauses, [[1, 2]])
+            self.assertRaises(RuntimeError, s.add_atmost, [1, 2], 1)
+            self.assertRaises(RuntimeError, s.value, 1)
+        finally:
+            t.join()
+        self.assertEqual(s.solve(timeout=0.01), "UNKNOWN")
+
+        # reentry from Python code run while adding clauses
+        s = pycosat.Solver()
+        def clauses():
+            yield [1, 2]
+            s.solve()
+        self.assertRaises(RuntimeError, s.add_clauses, clauses())
+        self.assertTrue(evaluate([[1, 2]], s.solve()))
+
+tests.append(TestSolver)
+
+# ------------------------------------------------------------------------
+
+def hard_cnf(nvars=250, seed=7):
+    # random 3-SAT at the phase transition, which takes picosat seconds
+    rnd = random.Random(seed)
+    return [[rnd.choice([-1, 1]) * rnd.randint(1, nvars) for _ in range(3)]
+            for _ in range(int(4.26 * nvars))]
+
+class TestTimeout(unittest.TestCase):
+
+    def assertFast(self, f, *args, **kwds):
+        t0 = time.monotonic()
+        res = f(*args, **kwds)
+        self.assertTrue(time.monotonic() - t0 < 2.0)
+        return res
+
+    def test_solve(self):
+        cnf = hard_cnf()
+        self.assertEqual(self.assertFast(solve, cnf, timeout=0.05),
+                         "UNKNOWN")
+        self.assertEqual(self.assertFast(solve, cnf,
+                                         deadline=time.monotonic() + 0.05),
+                         "UNKNOWN")
+        # the earlier of both counts
+        self.assertEqual(self.assertFast(solve, cnf, timeout=1000,
+                                         deadline=time.monotonic() + 0.05),
+                         "UNKNOWN")
+        self.assertEqual(self.assertFast(solve, cnf, timeout=0.05,
+                                         portfolio=2),
+                         "UNKNOWN")
+        # easy problems are not affected
+        self.assertEqual(solve(clauses1, timeout=10), [1, -2, -3, -4, 5])
+        self.assertEqual(solve(clauses1, timeout=None, deadline=None),
+                         [1, -2, -3, -4, 5])
+        self.assertRaises(TypeError, solve, clauses1, timeout='1')
+        self.assertRaises(ValueError, solve, clauses1, timeout=float('nan'))
+        self.assertRaises(ValueError, solve, clauses1, timeout=-1)
+        self.assertRaises(ValueError, solve, clauses1,
+                          deadline=float('nan'))
+        self.assertRaises(ValueError, pycosat.Solver().solve, timeout=-0.5)
+        # a deadline in the past is reached right away
+        self.assertEqual(solve(hard_cnf(), deadline=time.monotonic() - 1),
+                         "UNKNOWN")
+
+    def test_itersolve(self):
+        it = itersolve(hard_cnf(), timeout=0.05)
+        self.assertEqual(self.assertFast(list, it), [])
+        self.assertEqual(len(list(itersolve(clauses1, timeout=10))), 18)
+
+    def test_solver(self):
+        s = pycosat.Solver(hard_cnf())
+        self.assertEqual(self.assertFast(s.solve, timeout=0.05), "UNKNOWN")
+        self.assertEqual(self.assertFast(s.solve_batch, [[1], [-1], [2]],
+                                         deadline=time.monotonic() - 1),
+                         array('b', [-1, -1, -1]))
+        s = pycosat.Solver(clauses1)
+        self.assertEqual(s.solve(timeout=10), [1, -2, -3, -4, 5])
+
+tests.append(TestTimeout)
+
+# ------------------------------------------------------------------------
+
+class TestDimacs(unittest.TestCase):
+
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def write(self, data, name='test.cnf', compress=False):
+        path = os.path.join(self.tmpdir, name)
+        with (gzip.open if compress else open)(path, 'wb') as fo:
+            fo.write(data.encode('ascii'))
+        return path
+
+    def test_cnf1(self):
+        path = self.write("""\
+c a comment
+p cnf 5 5
+ 1 -5 4 0
+-1 5 3 4 0
+-3 -4 0
+-1 0
+-3 5 0
+""")
+        self.assertEqual(pycosat.solve_file(path), [-1, -2, -3, -4, -5])
+        self.assertEqual(pycosat.solve_file(path, output='bitset'), b'\x00')
+
+    def test_matches_solve(self):
+        for clauses in clauses1, clauses2, clauses3:
+            path = self.write(''.join('%s 0\n' % ' '.join(map(str, clause))
+                                      for clause in clauses))
+            self.assertEqual(pycosat.solve_file(path), solve(clauses))
+
+    def test_header_vars(self):
+        path = self.write("p cnf 7 1\n1 2 0\n")
+        self.assertEqual(len(pycosat.solve_file(path)), 7)
+
+    def test_header_oversized(self):
+        # the header is not trusted beyond what the file can hold
+        for compress in False, True:
+            path = self.write("p cnf 2000000000 1\n1 0\n",
+                              name='big.cnf' + '.gz' * compress,
+                              compress=compress)
+            try:
+                sol = pycosat.solve_file(path)
+            except ValueError as e:
+                self.assertTrue('zlib' in str(e))
+                continue
+            self.assertEqual(sol[0], 1)
+            self.assertTrue(len(sol) < 50000)
+            s = pycosat.Solver()
+            s.load_dimacs(path)
+            self.assertEqual(s.solve()[0], 1)
+
+    def test_no_trailing_newline(self):
+        path = self.write("p cnf 2 2\n1 2 0 -1 0")
+        self.assertEqual(pycosat.solve_file(path), [-1, 2])
+        path = self.write("")
+        self.assertEqual(pycosat.solve_file(path), [])
+
+    def test_percent(self):
+        # some benchmark files end with "%\n0\n"
+        path = self.write("p cnf 1 1\n-1 0\n%\n0\n")
+        self.assertEqual(pycosat.solve_file(path), [-1])
+
+    def test_unsat(self):
+        path = self.write("1 0\n-1 0\n")
+        self.assertEqual(pycosat.solve_file(path), "UNSAT")
+
+    def test_gzip(self):
+        path = self.write("p cnf 5 5\n1 -5 4 0 -1 5 3 4 0 -3 -4 0\n"
+                          "-1 0\n-3 5 0\n", name='test.cnf.gz',
+                          compress=True)
+        try:
+            self.assertEqual(pycosat.solve_file(path), [-1, -2, -3, -4, -5])
+        except ValueError as e:
+            self.assertTrue('zlib' in str(e))
+
+    def test_errors(self):
+        self.assertRaises(TypeError, pycosat.solve_file, 1)
+        self.assertRaises(OSError, pycosat.solve_file,
+                          os.path.join(self.tmpdir, 'missing.cnf'))
+        for data, line in [("1 2 0\n3 x 0\n", 2),
+                           ("1 -0 - 0\n", 1),
+                           ("p cnf x 1\n1 0\n", 1),
+                           ("1 0\n99999999999 0\n", 2),
+                           ("1 0\n1 2\n", 3)]:
+            path = self.write(data)
+            try:
+                pycosat.solve_file(path)
+            except ValueError as e:
+                self.assertTrue(str(e).startswith('%s:%d: ' % (path, line)))
+            else:
+                self.fail("ValueError not raised")
+
+    def test_solver(self):
+        path = self.write("c clauses1\n" +
+                          ''.join('%s 0\n' % ' '.join(map(str, clause))
+                                  for clause in clauses1))
+        s = pycosat.Solver()
+        s.load_dimacs(path)
+        self.assertEqual(s.solve(), [1, -2, -3, -4, 5])
+        # complete clauses before an error are kept
+        self.assertRaises(ValueError, s.load_dimacs,
+                          self.write("-1 0\n-2 x 0\n"))
+        self.assertEqual(s.solve(), [-1, -2, -3, -4, -5])
+
+tests.append(TestDimacs)
+
+# -----
+
+class TestEnumerateTo(unittest.TestCase):
+
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp()
+        self.path = os.path.join(self.tmpdir, 'models')
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def read(self):
+        with open(self.path, 'rb') as fi:
+            return fi.read()
+
+    def test_dimacs(self):
+        sols = list(itersolve(clauses1))
+        self.assertEqual(pycosat.enumerate_to(self.path, clauses1), 18)
+        lines = self.read().decode('ascii').splitlines()
+        self.assertEqual([[int(x) for x in line.split()] for line in lines],
+                         [sol + [0] for sol in sols])
+
+    def test_bitset(self):
+        sols = list(itersolve(clauses1, 7, output='bitset'))
+        self.assertEqual(pycosat.enumerate_to(self.path, clauses1,
+                                              format='bitset', vars=7), 72)
+        self.assertEqual(len(sols), 72)
+        self.assertEqual(self.read(), b''.join(sols))
+
+    def test_limit_project_cubes(self):
+        self.assertEqual(pycosat.enumerate_to(self.path, clauses1,
+                                              limit=5), 5)
+        self.assertEqual(len(self.read().splitlines()), 5)
+        self.assertEqual(pycosat.enumerate_to(self.path, clauses1,
+                                              project=[1, 2]), 4)
+        self.assertEqual(sorted(self.read().splitlines()),
+                         [b'-1 -2 0', b'-1 2 0', b'1 -2 0', b'1 2 0'])
+        n = pycosat.enumerate_to(self.path, clauses1, cubes=True)
+        self.assertEqual(
+            [[int(x) for x in line.split()]
+             for line in self.read().splitlines()],
+            [cube + [0] for cube in itersolve(clauses1, cubes=True)])
+        self.assertEqual(pycosat.enumerate_to(self.path, [[1], [-1]]), 0)
+        self.assertEqual(self.read(), b'')
+
+    def test_fd(self):
+        fd = os.open(self.path, os.O_WRONLY | os.O_CREAT)
+        try:
+            os.write(fd, b'c models\n')
+            self.assertEqual(pycosat.enumerate_to(fd, [[1, 2]]), 3)
+            # the file descriptor is left open
+            os.write(fd, b'c end\n')
+        finally:
+            os.close(fd)
+        lines = self.read().splitlines()
+        self.assertEqual((lines[0], lines[-1], len(lines)),
+                         (b'c models', b'c end', 5))
+
+    def test_errors(self):
+        self.assertRaises(ValueError, pycosat.enumerate_to, self.path,
+                          clauses1, format='list')
+        self.assertRaises(ValueError, pycosat.enumerate_to, self.path,
+                          clauses1, format='bitset', cubes=True)
+        self.assertRaises(OSError, pycosat.enumerate_to,
+                          os.path.join(self.tmpdir, 'no', 'such'), clauses1)
+        self.assertRaises(TypeError, pycosat.enumerate_to, self.path, [[1.]])
+        # the file is not touched, when the clauses are wrong
+        self.assertFalse(os.path.exists(self.path))
+
+tests.append(TestEnumerateTo)
+
+# ------------------------------------------------------------------------
+
+class TestCount(unittest.TestCase):
+
+    def test_clauses1(self):
+        self.assertEqual(pycosat.count(clauses1), 18)
+        self.assertEqual(pycosat.count(clauses1, vars=7), 72)
+        self.assertEqual(pycosat.count(clauses1, project=[1, 2]), 4)
+        self.assertEqual(pycosat.count(clauses1, project=[3, 4]),
+                         len(list(itersolve(clauses1, project=[3, 4]))))
+
+    def test_trivial(self):
+        self.assertEqual(pycosat.count([]), 1)
+        self.assertEqual(pycosat.count([], vars=3), 8)
+        self.assertEqual(pycosat.count([[1], [-1]]), 0)
+        self.assertEqual(pycosat.count([[1, 2], []]), 0)
+        self.assertEqual(pycosat.count([[1, -1, 2, 2]]), 4)
+        self.assertEqual(pycosat.count(array('i', [1, 2, 0, -1, 0])), 1)
+
+    def test_big(self):
+        # 100 independent components of 2 variables with 3 models each
+        cnf = [[2 * i + 1, 2 * i + 2] for i in range(100)]
+        self.assertEqual(pycosat.count(cnf), 3 ** 100)
+        self.assertEqual(pycosat.count([[1, -1]], vars=200), 2 ** 200)
+
+    def test_long_chain(self):
+        # branches once per level, which must not overflow a small C stack
+        n = 4000
+        cnf = [[i, i + 1] for i in range(1, n)]
+        res = []
+        size = threading.stack_size(1 << 16)
+        try:
+            t = threading.Thread(target=lambda: res.append(pycosat.count(cnf)))
+            t.start()
+            t.join()
+        finally:
+            threading.stack_size(size)
+        a, b = 1, 2             # models of chains of 0 and 1 variables
+        for _ in range(n):
+            a, b = b, a + b
+        self.assertEqual(res, [a])
+
+    def test_random(self):
+        rnd = random.Random(3)
+        for i in range(50):
+            n = rnd.randint(1, 10)
+            cnf = [[rnd.choice([-1, 1]) * rnd.randint(1, n)
+                    for _ in range(rnd.randint(1, 3))]
+                   for _ in range(rnd.randint(1, 25))]
+            project = rnd.sample(range(1, n + 1), rnd.randint(1, n))
+            self.assertEqual(pycosat.count(cnf, vars=n),
+                             len(list(itersolve(cnf, vars=n))))
+            self.assertEqual(pycosat.count(cnf, project=project),
+                             len(list(itersolve(cnf, project=project))))
+
+    def test_queens(self):
+        self.assertEqual(pycosat.count(queens(8)), 92)
+
+    def test_timeout(self):
+        t0 = time.monotonic()
+        self.assertEqual(pycosat.count(hard_cnf(), timeout=0.05), None)
+        self.assertTrue(time.monotonic() - t0 < 2.0)
+        self.assertEqual(pycosat.count(clauses1, timeout=10), 18)
+
+tests.append(TestCount)
+
+class TestSample(unittest.TestCase):
+
+    def test_clauses1(self):
+        sols = pycosat.sample(clauses1, 50, seed=1)
+        self.assertEqual(len(sols), 50)
+        for sol in sols:
+            self.assertEqual(len(sol), 5)
+            self.assertTrue(evaluate(clauses1, sol))
+        self.assertEqual(pycosat.sample(clauses1, 50, seed=1), sols)
+        sols = pycosat.sample(clauses1, 10, seed=2, output="positive")
+        self.assertEqual(len(sols), 10)
+
+    def test_trivial(self):
+        self.assertEqual(pycosat.sample([[1], [-1]], 5), [])
+        self.assertEqual(pycosat.sample([], 3), [[], [], []])
+        self.assertEqual(pycosat.sample(clauses1, 0), [])
+        self.assertEqual(pycosat.sample([[1]], 2, vars=2, seed=3,
+                                        project=[1]), [[1, -2], [1, -2]])
+        self.assertRaises(ValueError, pycosat.sample, clauses1, -1)
+
+    def test_uniform(self):
+        # 256 solutions, too many to enumerate them all at once
+        sols = pycosat.sample([], 2560, vars=8, seed=5)
+        self.assertEqual(len(sols), 2560)
+        counts = {}
+        for sol in sols:
+            counts[tuple(sol)] = counts.get(tuple(sol), 0) + 1
+        self.assertEqual(len(counts), 256)
+        chi2 = sum((c - 10) ** 2 / 10.0 for c in counts.values())
+        self.assertTrue(chi2 < 400, chi2)
+
+    def test_project(self):
+        cnf = queens(6)
+        sols = pycosat.sample(cnf, 40, project=range(1, 7), seed=4)
+        self.assertEqual(len(sols), 40)
+        for sol in sols:
+            self.assertTrue(evaluate(cnf, sol))
+        # the 4 solutions differ in their first row
+        self.assertEqual(len(set(tuple(sol[:6]) for sol in sols)), 4)
+
+    def test_timeout(self):
+        t0 = time.monotonic()
+        self.assertTrue(len(pycosat.sample(hard_cnf(), 5,
+                                           timeout=0.05)) < 5)
+        self.assertTrue(time.monotonic() - t0 < 2.0)
+
+tests.append(TestSample)
+
+class TestMinimize(unittest.TestCase):
+
+    def check(self, cnf, objective, n):
+        best = None
+        for sol in itersolve(cnf, vars=n):
+            cost = sum(w for w, lit in objective if lit in sol)
+            if best is None or cost < best:
+                best = cost
+        res = pycosat.minimize(cnf, objective, vars=n)
+        if best is None:
+            self.assertEqual(res, "UNSAT")
+            return
+        sol, cost = res
+        self.assertTrue(evaluate(cnf, sol))
+        self.assertEqual(cost, best)
+        self.assertEqual(sum(w for w, lit in objective if lit in sol), cost)
+
+    def test_clauses1(self):
+        sol, cost = pycosat.minimize(clauses1, [(1, 1), (1, -2)])
+        self.assertEqual(cost, 0)
+        self.assertEqual(sol[:2], [-1, 2])
+        sol, cost = pycosat.minimize(clauses1, [(1, -v) for v in range(1, 6)])
+        self.assertEqual(cost, 1)
+        self.check(clauses1, [(3, 1), (2, 2), (2, 5), (-1, 3)], 5)
+
+    def test_trivial(self):
+        self.assertEqual(pycosat.minimize([[1], [-1]], [(1, 1)]), "UNSAT")
+        self.assertEqual(pycosat.minimize([], []), ([], 0))
+        self.assertEqual(pycosat.minimize([[1, 2]], [(5, 1), (7, 2)]),
+                         ([1, -2], 5))
+        self.assertEqual(pycosat.minimize([], [(-2, 1), (3, -1)]),
+                         ([1], -2))
+        self.assertRaises(ValueError, pycosat.minimize, [], [(1, 2, 3)])
+        self.assertRaises(TypeError, pycosat.minimize, [], [(1, "a")])
+
+    def test_random(self):
+        rnd = random.Random(11)
+        for i in range(100):
+            n = rnd.randint(1, 8)
+            cnf = [[rnd.choice([-1, 1]) * rnd.randint(1, n)
+                    for _ in range(rnd.randint(1, 3))]
+                   for _ in range(rnd.randint(0, 3 * n))]
+            objective = [(rnd.randint(-3, 9),
+                          rnd.choice([-1, 1]) * rnd.randint(1, n))
+                         for _ in range(rnd.randint(0, 2 * n))]
+            self.check(cnf, objective, n)
+
+    def test_queens(self):
+        # fewest queens on the main diagonal
+        cnf = queens(8)
+        sol, cost = pycosat.minimize(cnf, [(1, 9 * i + 1) for i in range(8)])
+        self.assertEqual(cost, 0)
+        self.assertTrue(evaluate(cnf, sol))
+
+    def test_timeout(self):
+        self.assertEqual(pycosat.minimize(hard_cnf(), [(1, 1)],
+                                          timeout=0.05), "UNKNOWN")
+        self.assertEqual(pycosat.minimize(hard_cnf(), [(1, 1)], k=3,
+                                          timeout=0.05), [])
+
+    def check_best(self, cnf, objective, n, k, project=None):
+        # the least cost of each distinct (projected) solution
+        best = {}
+        for sol in itersolve(cnf, vars=n):
+            cost = sum(w for w, lit in objective if lit in sol)
+            key = tuple(lit for lit in sol
+                        if project is None or abs(lit) in project)
+            if key not in best or cost < best[key]:
+                best[key] = cost
+        res = pycosat.minimize(cnf, objective, vars=n, k=k, project=project)
+        self.assertEqual([cost for sol, cost in res],
+                         sorted(best.values())[:k])
+        for sol, cost in res:
+            self.assertEqual(best[tuple(sol)], cost)
+        self.assertEqual(len(set(tuple(sol) for sol, cost in res)),
+                         len(res))
+
+    def test_best(self):
+        self.assertEqual(pycosat.minimize([[1, 2]], [(5, 1), (7, 2)], k=5),
+                         [([1, -2], 5), ([-1, 2], 7), ([1, 2], 12)])
+        self.assertEqual(pycosat.minimize([[1], [-1]], [(1, 1)], k=2), [])
+        self.assertEqual(pycosat.minimize([[1, 2], [3]], [(1, 2)],
+                                          project=[1]), ([1], 0))
+        self.assertEqual(pycosat.minimize([[1, 2]], [(1, 1)], k=1),
+                         [([-1, 2], 0)])
+        self.assertRaises(ValueError, pycosat.minimize, [], [], k=0)
+        self.check_best(clauses1, [(3, 1), (2, 2), (2, 5), (-1, 3)], 5, 10)
+        self.check_best(clauses1, [(1, -1), (1, 4)], 5, 3, project=[1, 4])
+        rnd = random.Random(5)
+        for i in range(100):
+            n = rnd.randint(1, 7)
+            cnf = [[rnd.choice([-1, 1]) * rnd.randint(1, n)
+                    for _ in range(rnd.randint(1, 3))]
+                   for _ in range(rnd.randint(0, 2 * n))]
+            objective = [(rnd.randint(-3, 9),
+                          rnd.choice([-1, 1]) * rnd.randint(1, n))
+                         for _ in range(rnd.randint(0, 2 * n))]
+            project = (sorted(rnd.sample(range(1, n + 1), rnd.randint(0, n)))
+                       if i % 3 == 0 else None)
+            self.check_best(cnf, objective, n, rnd.randint(1, 10), project)
+
+tests.append(TestMinimize)
+
+class TestMinimizeLex(unittest.TestCase):
+
+    def check(self, cnf, objectives, n):
+        best = None
+        for sol in itersolve(cnf, vars=n):
+            costs = [sum(w for w, lit in obj if lit in sol)
+                     for obj in objectives]
+            if best is None or costs < best:
+                best = costs
+        res = pycosat.minimize_lex(cnf, objectives, vars=n)
+        if best is None:
+            self.assertEqual(res, "UNSAT")
+            return
+        sol, costs = res
+        self.assertTrue(evaluate(cnf, sol))
+        self.assertEqual(costs, best)
+        self.assertEqual([sum(w for w, lit in obj if lit in sol)
+                          for obj in objectives], costs)
+
+    def test_clauses1(self):
+        sol, costs = pycosat.minimize_lex(clauses1, [[(1, 1)], [(1, 2)]])
+        self.assertEqual(costs, [0, 0])
+        self.assertEqual(sol[:2], [-1, -2])
+        self.check(clauses1, [[(1, -3), (1, -4)], [(2, 1), (1, 5)]], 5)
+
+    def test_trivial(self):
+        self.assertEqual(pycosat.minimize_lex([[1], [-1]], [[(1, 1)]]),
+                         "UNSAT")
+        self.assertEqual(pycosat.minimize_lex([], []), ([], []))
+        self.assertEqual(pycosat.minimize_lex([[1, 2]], []), ([1, 2], []))
+        self.assertEqual(pycosat.minimize_lex([[1, 2]],
+                                              [[(1, 1), (1, 2)], [(1, 1)]]),
+                         ([-1, 2], [1, 0]))
+        self.assertEqual(pycosat.minimize_lex([], [[], [(3, -1)]]),
+                         ([1], [0, 0]))
+        self.assertRaises(TypeError, pycosat.minimize_lex, [], 5)
+        self.assertRaises(ValueError, pycosat.minimize_lex, [], [[(1,)]])
+
+    def test_random(self):
+        rnd = random.Random(21)
+        for i in range(100):
+            n = rnd.randint(1, 8)
+            cnf = [[rnd.choice([-1, 1]) * rnd.randint(1, n)
+                    for _ in range(rnd.randint(1, 3))]
+                   for _ in range(rnd.randint(0, 3 * n))]
+            objectives = [[(rnd.randint(-3, 9),
+                            rnd.choice([-1, 1]) * rnd.randint(1, n))
+                           for _ in range(rnd.randint(0, n))]
+                          for _ in range(rnd.randint(1, 3))]
+            self.check(cnf, objectives, n)
+
+    def test_timeout(self):
+        self.assertEqual(pycosat.minimize_lex(hard_cnf(), [[(1, 1)]],
+                                              timeout=0.05), "UNKNOWN")
+
+tests.append(TestMinimizeLex)
+
 # ------------------------------------------------------------------------
 
 def run(verbosity=1, repeat=1):